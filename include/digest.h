@@ -0,0 +1,64 @@
+/*******************************************************************************
+ * Digest Library
+ * Copyright (C) 2026 Aaron Clovsky
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#ifndef DIGEST_HEADER
+#define DIGEST_HEADER
+
+/*******************************************************************************
+Headers
+*******************************************************************************/
+#include <stddef.h>
+#include <stdint.h>
+
+/*******************************************************************************
+Types
+*******************************************************************************/
+/* Running CRC32, MD5 and SHA-1 state
+   Note: MD5 and SHA-1 share the 64 byte block buffer */
+typedef struct
+{
+    uint32_t crc32;
+    uint32_t md5[4];
+    uint32_t sha1[5];
+    uint64_t length;
+    uint8_t  block[64];
+} digest;
+
+typedef struct
+{
+    uint32_t crc32;
+    uint8_t  md5[16];
+    uint8_t  sha1[20];
+} digest_result;
+
+/*******************************************************************************
+External functions
+*******************************************************************************/
+/* Initialize digest state */
+void digest_init(digest * state);
+
+/* Feed data into all digests */
+void digest_update(digest * state, const void * data, size_t size);
+
+/* Finalize digests
+   Note: state must be re-initialized before reuse */
+void digest_final(digest * state, digest_result * result);
+
+/* Format result as "<crc32> <md5> <sha1>" in lowercase hex
+   Note: str must point to at least 83 bytes */
+void digest_string(const digest_result * result, char * str);
+
+#endif
@@ -0,0 +1,37 @@
+/*******************************************************************************
+ * Large File Helpers
+ * Copyright (C) 2026 Aaron Clovsky
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+#ifndef FILEIO_HEADER
+#define FILEIO_HEADER
+
+/*******************************************************************************
+Headers
+*******************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+
+/*******************************************************************************
+External functions
+*******************************************************************************/
+/* Seek to an absolute 64 bit offset
+   Returns zero on success */
+int fileio_seek(FILE * f, uint64_t offset);
+
+/* Determine the size of a file, leaving the position at the start
+   Returns zero on success */
+int fileio_size(FILE * f, uint64_t * size);
+
+#endif
@@ -36,6 +36,7 @@ Macros
 /*******************************************************************************
 Headers
 *******************************************************************************/
+#include <stddef.h>
 #include <stdint.h>
 
 /*******************************************************************************
@@ -47,7 +48,9 @@ typedef enum
     SECTOR_ERROR_INVALID_SYNC        = 1,
     SECTOR_ERROR_INVALID_MODE        = 2,
     SECTOR_ERROR_MODE_2_F1_AMBIGUOUS = 3,
-    SECTOR_ERROR_MODE_2_F2_AMBIGUOUS = 4
+    SECTOR_ERROR_MODE_2_F2_AMBIGUOUS = 4,
+    SECTOR_ERROR_ABORTED             = 5,
+    SECTOR_ERROR_TRUNCATED           = 6
 } sector_error;
 
 typedef enum
@@ -60,6 +63,21 @@ typedef enum
     SECTOR_MODE_2_FORM_2 = 5
 } sector_mode;
 
+/* Mode 2 XA subheader submode bits
+   Note: The subheader is file number, channel number, submode and coding
+   info, stored twice */
+typedef enum
+{
+    SECTOR_SUBMODE_EOR       = 0x01,
+    SECTOR_SUBMODE_VIDEO     = 0x02,
+    SECTOR_SUBMODE_AUDIO     = 0x04,
+    SECTOR_SUBMODE_DATA      = 0x08,
+    SECTOR_SUBMODE_TRIGGER   = 0x10,
+    SECTOR_SUBMODE_FORM_2    = 0x20,
+    SECTOR_SUBMODE_REAL_TIME = 0x40,
+    SECTOR_SUBMODE_EOF       = 0x80
+} sector_submode;
+
 SECTOR_PACK_DEF(struct, sector_header, {
     uint8_t sync[12];
     uint8_t offset[3];
@@ -107,6 +125,59 @@ SECTOR_PACK_DEF(union, sector, {
     sector_mode_2_form_2 mode_2_form_2;
 });
 
+/* Header address continuity check results */
+typedef enum
+{
+    SECTOR_ADDRESS_OK           = 0,
+    SECTOR_ADDRESS_NONE         = 1,
+    SECTOR_ADDRESS_INVALID      = 2,
+    SECTOR_ADDRESS_GAP          = 3,
+    SECTOR_ADDRESS_DUPLICATE    = 4,
+    SECTOR_ADDRESS_OUT_OF_ORDER = 5
+} sector_address_status;
+
+/* Header address continuity check context
+   Notes:
+   - Addresses are absolute frame numbers (minute * 4500 + second * 75 +
+     frame), 00:02:00 (LBA 0) is 150
+   - The expected address of a sector is derived from its position relative
+     to the last sector that re-synchronized the check, so sectors without a
+     header (CD-DA) may be skipped freely */
+typedef struct
+{
+    int      started;
+    uint32_t base_address;
+    uint32_t base_sector;
+    uint32_t previous;
+    uint32_t previous_sector;
+} sector_address_check;
+
+/* Streaming decoder callback
+   Notes:
+   - sector points to the complete 2352 byte sector and data to its user data,
+     both usually point into the pushed buffer and are only valid for the
+     duration of the call
+   - error is the sector_analyze() result, mode and data are only meaningful
+     when it is not SECTOR_ERROR_INVALID_SYNC or SECTOR_ERROR_INVALID_MODE
+   - Return non-zero to stop decoding */
+typedef int (*sector_stream_callback)(void *       user,
+                                      uint32_t     sector_num,
+                                      const void * sector,
+                                      sector_error error,
+                                      sector_mode  mode,
+                                      const void * data);
+
+/* Streaming decoder context
+   Note: Allocated by the caller, the library never allocates memory */
+typedef struct
+{
+    sector_stream_callback callback;
+    void *                 user;
+    uint32_t               sector_num;
+    unsigned               carry_size;
+    uint8_t                carry[2352];
+} sector_stream;
+
 /*******************************************************************************
 External functions
 *******************************************************************************/
@@ -126,10 +197,91 @@ uint32_t sector_calc_edc(const void * sector, sector_mode mode);
    - Writes nothing to *ecc if ECC cannot be calculated for the given mode*/
 void sector_calc_ecc(const void * sector, sector_mode mode, uint8_t * ecc);
 
+/* Build a complete sector from address, mode, subheader and data
+   Notes:
+   - sector must point to 2352 bytes
+   - offset is the 3 byte BCD address stored in the sector header
+   - sub_header (8 bytes) is only read for Mode 2 Form 1/2, may be NULL
+     otherwise
+   - data must point to sector_data_size(mode) bytes
+   - EDC and ECC are regenerated where the mode has them */
+sector_error sector_encode(void *          sector,
+                           const uint8_t * offset,
+                           sector_mode     mode,
+                           const uint8_t * sub_header,
+                           const void *    data);
+
+/* Advance a BCD header address (minute, second, frame) by one sector
+   Notes:
+   - offset and next may point to the same 3 bytes
+   - Returns zero and writes nothing if offset is not a valid address */
+int sector_offset_next(const uint8_t * offset, uint8_t * next);
+
+/* Decode a BCD header address to an absolute frame number
+   Returns zero and writes nothing if offset is not a valid address */
+int sector_offset_decode(const uint8_t * offset, uint32_t * address);
+
+/* Encode an absolute frame number as a BCD header address
+   Note: address wraps at 100 minutes */
+void sector_offset_encode(uint32_t address, uint8_t * offset);
+
+/* Initialize a header address continuity check */
+void sector_address_check_init(sector_address_check * check);
+
+/* Check the header address of one sector against its position
+   Notes:
+   - Sectors without sync return SECTOR_ADDRESS_NONE and are ignored
+   - The first sector with a valid address sets the baseline
+   - A sector that continues the address sequence of the previous checked
+     sector re-synchronizes the check, so a shifted run of sectors (e.g. after
+     missing or repeated sectors) is reported once rather than per sector */
+sector_address_status sector_address_check_sector(sector_address_check * check,
+                                                  const void * sector,
+                                                  uint32_t     sector_num);
+
+/* Check the header addresses of consecutive sectors
+   Notes:
+   - sectors points to count * 2352 bytes, the first being sector_num
+   - Stops after the first sector that is neither SECTOR_ADDRESS_OK nor
+     SECTOR_ADDRESS_NONE and stores its result in *status, otherwise stores
+     SECTOR_ADDRESS_OK
+   - Returns the number of sectors consumed */
+uint32_t sector_address_check_sectors(sector_address_check *  check,
+                                      const void *            sectors,
+                                      uint32_t                sector_num,
+                                      uint32_t                count,
+                                      sector_address_status * status);
+
+/* Size of the user data for a mode
+   Returns zero for SECTOR_MODE_INVALID */
+unsigned sector_data_size(sector_mode mode);
+
+/* Initialize a streaming decoder */
+void sector_stream_init(sector_stream *        stream,
+                        sector_stream_callback callback,
+                        void *                 user);
+
+/* Decode an arbitrary chunk of a raw image, calling back once per sector
+   Notes:
+   - size need not be a multiple of 2352, a trailing partial sector is
+     carried over to the next push, this is the only copy made
+   - Returns SECTOR_ERROR_ABORTED if the callback returned non-zero, the
+     stream must be re-initialized before further use */
+sector_error sector_stream_push(sector_stream * stream,
+                                const void *    data,
+                                size_t          size);
+
+/* Finish decoding
+   Returns SECTOR_ERROR_TRUNCATED if a partial sector is left over */
+sector_error sector_stream_finish(sector_stream * stream);
+
 /* Stringify mode */
 const char * sector_mode_string(sector_mode mode);
 
 /* Stringify error */
 const char * sector_error_string(sector_error error);
 
+/* Stringify address check result */
+const char * sector_address_string(sector_address_status status);
+
 #endif
@@ -6,4 +6,14 @@ bin\calc_sector_lookup_tables_h.exe > include\sector_lookup_tables.h
 
 del /Q bin\calc_sector_lookup_tables_h.exe
 
-cl -Iinclude src\bin2iso.c src\sector.c /Febin\bin2iso.exe
+cl src\calc_digest_lookup_tables_h.c /Febin\calc_digest_lookup_tables_h.exe
+
+bin\calc_digest_lookup_tables_h.exe > include\digest_lookup_tables.h
+
+del /Q bin\calc_digest_lookup_tables_h.exe
+
+cl -Iinclude src\bin2iso.c src\sector.c src\digest.c src\fileio.c /Febin\bin2iso.exe
+
+cl -Iinclude src\binstore.c src\sector.c src\digest.c /Febin\binstore.exe
+
+cl -Iinclude src\binpatch.c src\sector.c src\digest.c src\fileio.c /Febin\binpatch.exe
@@ -19,10 +19,19 @@
 Headers
 *******************************************************************************/
 #include <sector.h>
+#include <digest.h>
+#include <fileio.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <pthread.h>
+#endif
+
 /*******************************************************************************
 Utilities
 *******************************************************************************/
@@ -46,123 +55,1565 @@ void help_exit(const char * arg)
 
     name = name ? &name[1] : arg;
 
-    printf("Usage: %s <input .bin> <output .iso>\n", name);
+    printf("Usage: %s [-d] [-c <cue> [-a <prefix>]]"
+           " <input .bin> <output .iso>\n"
+           "       %s [-d] [-c <cue> [-a <prefix>]] -x <input .bin> <prefix>\n"
+           "       %s -b [-j <threads>] [-m <MiB>] <manifest>\n",
+           name,
+           name,
+           name);
+    printf("  -d  Print CRC32, MD5 and SHA-1 of raw sectors and of data\n"
+           "      for the image and for each cue sheet track\n"
+           "  -x  Demultiplex Mode 2 XA sectors into one file per file\n"
+           "      number, channel and form:\n"
+           "      <prefix>_<file>_<channel>.form<1|2>, Form 1 as 2048\n"
+           "      byte data, Form 2 as 2336 byte subheader+data+EDC\n");
+    printf("  -c  Take track boundaries and types from a single-file cue\n"
+           "      sheet, audio tracks are skipped unless -a is given\n"
+           "  -a  Extract the cue sheet's CD-DA tracks to\n"
+           "      <prefix>_<track>.wav, requires -c\n");
+    printf("  -b  Convert every \"<input .bin><TAB><output .iso>\" line of\n"
+           "      manifest, largest images first, split into chunks\n"
+           "  -j  Batch worker threads (default 4)\n"
+           "  -m  Batch input MiB being converted at once over all\n"
+           "      workers, limits disk load independently of -j\n"
+           "      (default 128, chunks are 18.4 MiB)\n");
 
     exit(2);
 }
 
 /*******************************************************************************
-main()
+Header address checking
 *******************************************************************************/
-int main(int argc, const char ** argv)
+#define ADDRESS_WARNINGS 16 /* Per-sector warnings printed per file or chunk */
+
+/* Report a header address anomaly, only the first few are printed */
+void address_warning(const char *          name,
+                     unsigned long         sector_num,
+                     const void *          sector,
+                     sector_address_status status,
+                     unsigned long *       count)
 {
-    FILE *   in;
-    FILE *   out;
-    unsigned sector_num;
+    const uint8_t * offset;
 
-    sector_num = 0;
+    offset = (const uint8_t *)sector + 12;
 
-    /* Check args */
-    if (argc != 3)
+    if (++*count <= ADDRESS_WARNINGS)
     {
-        help_exit(argv[0]);
+        printf("Warning: %s: sector %lu: address %02X:%02X:%02X: %s\n",
+               name,
+               sector_num,
+               offset[0],
+               offset[1],
+               offset[2],
+               sector_address_string(status));
     }
+}
 
-    /* Open input file */
-    if ((!(in = fopen(argv[1], "rb"))))
-    {
-        perror_exit("Error opening input file");
-    }
+/*******************************************************************************
+XA demultiplexer
+*******************************************************************************/
+#define DEMUX_STREAMS     (256 * 256 * 2)
+#define DEMUX_BUFFER_SIZE 65536
 
-    /* Check that the input file size is divisible by 2352 */
+typedef struct
+{
+    FILE *        out;
+    unsigned long sectors;
+} demux_stream;
+
+/* Return the output stream for a subheader, opening it on first use
+   Returns NULL on error */
+demux_stream * demux_open(demux_stream *  streams,
+                          const char *    prefix,
+                          const uint8_t * sub_header)
+{
+    demux_stream * stream;
+    unsigned       form;
+
+    form   = (sub_header[2] & SECTOR_SUBMODE_FORM_2) ? 2 : 1;
+    stream = &streams[(sub_header[0] * 256 + sub_header[1]) * 2 + form - 1];
+
+    if (!stream->out)
     {
-        long in_size;
+        char * name;
 
-        if (fseek(in, 0, SEEK_END) == -1)
+        if ((!(name = (char *)malloc(strlen(prefix) + 32))))
         {
-            perror_exit("Error determining size of input file");
+            perror("Error allocating memory");
+
+            return NULL;
         }
 
-        if ((in_size = ftell(in)) == -1)
+        sprintf(name,
+                "%s_%03u_%03u.form%u",
+                prefix,
+                (unsigned)sub_header[0],
+                (unsigned)sub_header[1],
+                form);
+
+        if ((!(stream->out = fopen(name, "wb"))))
         {
-            perror_exit("Error determining size of input file");
+            perror("Error opening output file");
+            free(name);
+
+            return NULL;
         }
 
-        if (in_size % 2352 != 0)
+        /* Give every stream its own large buffer so interleaved sectors do
+           not turn into small scattered writes */
+        setvbuf(stream->out, NULL, _IOFBF, DEMUX_BUFFER_SIZE);
+
+        printf("Opened %s\n", name);
+
+        free(name);
+    }
+
+    return stream;
+}
+
+/* Flush and close all streams, printing a summary
+   Returns 0 on success, every stream is closed either way */
+int demux_close(demux_stream * streams)
+{
+    unsigned long i;
+    int           result;
+
+    result = 0;
+
+    for (i = 0; i < DEMUX_STREAMS; i++)
+    {
+        if (streams[i].out)
         {
-            fprintf(stderr, "Error: Input file size not divisible by 2352\n");
+            if (fclose(streams[i].out) != 0)
+            {
+                perror("Error writing output file");
 
-            exit(1);
-        }
+                result = -1;
+            }
 
-        rewind(in);
+            streams[i].out = NULL;
+
+            printf("File %lu, channel %lu, form %lu: %lu sectors\n",
+                   i / 512,
+                   (i / 2) % 256,
+                   i % 2 + 1,
+                   streams[i].sectors);
+        }
     }
 
-    /* Open output file */
-    if ((!(out = fopen(argv[2], "wb"))))
+    return result;
+}
+
+/*******************************************************************************
+Cue sheet
+*******************************************************************************/
+#define CUE_MAX_TRACKS 99
+
+typedef struct
+{
+    unsigned      number;
+    int           audio;
+    unsigned long start;   /* First sector, INDEX 00 when there is a pregap */
+    unsigned long index_1; /* Sector of INDEX 01 */
+} cue_track;
+
+/* Read track numbers, types and start positions from a single-file cue
+   sheet, returns the number of tracks
+   Note: A pregap (INDEX 00) belongs to its own track, not the one before */
+unsigned cue_read(const char * name, cue_track * tracks)
+{
+    FILE *   cue;
+    char     line[1024];
+    unsigned count;
+    unsigned files;
+
+    if ((!(cue = fopen(name, "r"))))
     {
-        perror_exit("Error opening output file");
+        perror_exit("Error opening cue sheet");
     }
 
-    /* Copy disc image data sector by sector */
+    count = 0;
+    files = 0;
+
+    while (fgets(line, sizeof(line), cue))
     {
-        sector_error error;
-        char         sector[2352];
-        const void * data;
-        sector_mode  mode;
+        char     keyword[16];
+        char     type[16];
+        unsigned number;
+        unsigned m;
+        unsigned s;
+        unsigned f;
 
-        while (fread(&sector[0], 2352, 1, in) == 1)
+        if (sscanf(line, " %15s", keyword) != 1)
         {
-            error = sector_analyze(&sector[0], &data, &mode);
+            continue;
+        }
 
-            if (error)
+        if (strcmp(keyword, "FILE") == 0)
+        {
+            files++;
+        }
+        else if (strcmp(keyword, "TRACK") == 0)
+        {
+            if (sscanf(line, " TRACK %u %15s", &number, type) != 2 ||
+                count == CUE_MAX_TRACKS)
             {
-                if (error == SECTOR_ERROR_MODE_2_F1_AMBIGUOUS ||
-                    error == SECTOR_ERROR_MODE_2_F2_AMBIGUOUS)
-                {
-                    printf("Warning: sector_analyze_sector(%u): %s\n",
-                           sector_num,
-                           sector_error_string(error));
-                }
-                else
-                {
-                    fprintf(stderr,
-                            "Error: sector_analyze_sector(%u): %s\n",
-                            sector_num,
-                            sector_error_string(error));
+                fprintf(stderr, "Error: Invalid cue sheet line: %s", line);
 
-                    exit(1);
-                }
+                exit(1);
             }
 
-            if (mode != SECTOR_MODE_1 && mode != SECTOR_MODE_2_FORM_1)
+            tracks[count].number  = number;
+            tracks[count].audio   = strcmp(type, "AUDIO") == 0;
+            tracks[count].start   = (unsigned long)-1;
+            tracks[count].index_1 = (unsigned long)-1;
+            count++;
+        }
+        else if (strcmp(keyword, "INDEX") == 0 && count)
+        {
+            if (sscanf(line, " INDEX %u %u:%u:%u", &number, &m, &s, &f) != 4)
             {
-                fprintf(stderr,
-                        "Error: sector_analyze_sector(%u): "
-                        "Non-data sector: %s\n",
-                        sector_num,
-                        sector_mode_string(mode));
+                fprintf(stderr, "Error: Invalid cue sheet line: %s", line);
 
                 exit(1);
             }
 
-            if (fwrite(data, 2048, 1, out) != 1)
+            if (number == 0)
+            {
+                tracks[count - 1].start = ((unsigned long)m * 60 + s) * 75 + f;
+            }
+            else if (number == 1)
             {
-                perror_exit("Error writing output file");
+                tracks[count - 1].index_1 =
+                    ((unsigned long)m * 60 + s) * 75 + f;
             }
+        }
+    }
+
+    if (ferror(cue))
+    {
+        perror_exit("Error reading cue sheet");
+    }
+
+    fclose(cue);
+
+    if (files > 1)
+    {
+        fprintf(stderr, "Error: Multi-file cue sheets are not supported\n");
+
+        exit(1);
+    }
+
+    if (!count)
+    {
+        fprintf(stderr, "Error: No tracks in cue sheet\n");
 
-            sector_num++;
+        exit(1);
+    }
+
+    for (files = 0; files < count; files++)
+    {
+        if (tracks[files].start == (unsigned long)-1)
+        {
+            tracks[files].start = tracks[files].index_1;
         }
 
-        if (ferror(in))
+        if (tracks[files].index_1 == (unsigned long)-1 ||
+            tracks[files].start > tracks[files].index_1 ||
+            (files && tracks[files].start < tracks[files - 1].index_1))
         {
-            perror_exit("Error reading input file");
+            fprintf(stderr, "Error: Invalid INDEX in cue sheet\n");
+
+            exit(1);
         }
     }
 
-    /* Cleanup */
-    fclose(in);
-    fclose(out);
+    /* The first track owns everything before it */
+    tracks[0].start = 0;
+
+    return count;
+}
+
+/*******************************************************************************
+CD-DA tracks
+*******************************************************************************/
+typedef struct
+{
+    FILE *        out;
+    unsigned      number;
+    unsigned long sectors;
+} audio_track;
+
+/* Write a 16 bit stereo 44.1kHz PCM WAV header for size bytes of data */
+int wav_header(FILE * out, unsigned long size)
+{
+    uint8_t  header[44];
+    uint32_t values[4];
+    unsigned i;
+
+    memset(&header[0], 0, 44);
+    memcpy(&header[0], "RIFF", 4);
+    memcpy(&header[8], "WAVEfmt ", 8);
+    memcpy(&header[36], "data", 4);
+
+    values[0] = (uint32_t)size + 36;
+    values[1] = 16;
+    values[2] = 44100;
+    values[3] = 44100 * 4;
+
+    for (i = 0; i < 4; i++)
+    {
+        header[4 + i]  = (uint8_t)(values[0] >> (i * 8));
+        header[16 + i] = (uint8_t)(values[1] >> (i * 8));
+        header[24 + i] = (uint8_t)(values[2] >> (i * 8));
+        header[28 + i] = (uint8_t)(values[3] >> (i * 8));
+        header[40 + i] = (uint8_t)((uint32_t)size >> (i * 8));
+    }
+
+    header[20] = 1;  /* PCM */
+    header[22] = 2;  /* Channels */
+    header[32] = 4;  /* Block align */
+    header[34] = 16; /* Bits per sample */
+
+    return fwrite(&header[0], 44, 1, out) == 1 ? 0 : -1;
+}
+
+/* Start writing a track to <prefix>_<number>.wav */
+int audio_open(audio_track * track, const char * prefix, unsigned number)
+{
+    char * name;
+
+    if ((!(name = (char *)malloc(strlen(prefix) + 16))))
+    {
+        perror("Error allocating memory");
+
+        return -1;
+    }
+
+    sprintf(name, "%s_%02u.wav", prefix, number);
+
+    track->number  = number;
+    track->sectors = 0;
+
+    if ((!(track->out = fopen(name, "wb"))) || wav_header(track->out, 0))
+    {
+        perror("Error opening audio output file");
+        free(name);
+
+        return -1;
+    }
+
+    printf("Opened %s\n", name);
+
+    free(name);
+
+    return 0;
+}
+
+/* Finish the WAV header and print the track summary */
+int audio_close(audio_track * track)
+{
+    int result;
+
+    if (!track->out)
+    {
+        return 0;
+    }
+
+    result = fseek(track->out, 0, SEEK_SET) == -1 ||
+             wav_header(track->out, track->sectors * 2352) ||
+             fclose(track->out) != 0;
+
+    track->out = NULL;
+
+    if (result)
+    {
+        perror("Error writing audio output file");
+
+        return -1;
+    }
+
+    printf("Track %02u: %lu audio sectors\n", track->number, track->sectors);
+
+    return 0;
+}
+
+/*******************************************************************************
+Threads
+*******************************************************************************/
+#ifdef _WIN32
+typedef HANDLE             thread;
+typedef CRITICAL_SECTION   mutex;
+typedef CONDITION_VARIABLE condition;
+
+    #define THREAD_FUNCTION(__name__) DWORD WINAPI __name__(LPVOID arg)
+
+/* Start a thread, returns 0 on success */
+int thread_create(thread * t, LPTHREAD_START_ROUTINE fn, void * arg)
+{
+    return (*t = CreateThread(NULL, 0, fn, arg, 0, NULL)) ? 0 : -1;
+}
+
+void thread_join(thread t)
+{
+    WaitForSingleObject(t, INFINITE);
+    CloseHandle(t);
+}
+
+void mutex_init(mutex * m)
+{
+    InitializeCriticalSection(m);
+}
+
+void mutex_lock(mutex * m)
+{
+    EnterCriticalSection(m);
+}
+
+void mutex_unlock(mutex * m)
+{
+    LeaveCriticalSection(m);
+}
+
+void mutex_destroy(mutex * m)
+{
+    DeleteCriticalSection(m);
+}
+
+void condition_init(condition * c)
+{
+    InitializeConditionVariable(c);
+}
+
+void condition_wait(condition * c, mutex * m)
+{
+    SleepConditionVariableCS(c, m, INFINITE);
+}
+
+void condition_broadcast(condition * c)
+{
+    WakeAllConditionVariable(c);
+}
+
+void condition_destroy(condition * c)
+{
+    (void)c;
+}
+#else
+typedef pthread_t       thread;
+typedef pthread_mutex_t mutex;
+typedef pthread_cond_t  condition;
+
+    #define THREAD_FUNCTION(__name__) void * __name__(void * arg)
+
+/* Start a thread, returns 0 on success */
+int thread_create(thread * t, void * (*fn)(void *), void * arg)
+{
+    return pthread_create(t, NULL, fn, arg);
+}
+
+void thread_join(thread t)
+{
+    pthread_join(t, NULL);
+}
+
+void mutex_init(mutex * m)
+{
+    pthread_mutex_init(m, NULL);
+}
+
+void mutex_lock(mutex * m)
+{
+    pthread_mutex_lock(m);
+}
+
+void mutex_unlock(mutex * m)
+{
+    pthread_mutex_unlock(m);
+}
+
+void mutex_destroy(mutex * m)
+{
+    pthread_mutex_destroy(m);
+}
+
+void condition_init(condition * c)
+{
+    pthread_cond_init(c, NULL);
+}
+
+void condition_wait(condition * c, mutex * m)
+{
+    pthread_cond_wait(c, m);
+}
+
+void condition_broadcast(condition * c)
+{
+    pthread_cond_broadcast(c);
+}
+
+void condition_destroy(condition * c)
+{
+    pthread_cond_destroy(c);
+}
+#endif
+
+/*******************************************************************************
+Batch conversion
+*******************************************************************************/
+#define BATCH_CHUNK_SECTORS 8192 /* 18.4 MiB of input per chunk */
+#define BATCH_READ_SECTORS  256  /* Sectors read and address checked at once */
+#define BATCH_SEED_SECTORS  16   /* Preceding sectors that seed a chunk check */
+#define BATCH_MAX_THREADS   64
+
+typedef struct
+{
+    char *        in_name;
+    char *        out_name;
+    unsigned long sectors;
+    unsigned long chunks_left;
+    unsigned long address_errors;
+    int           failed;
+    char          error[512];
+} batch_job;
+
+typedef struct
+{
+    batch_job *   job;
+    unsigned long first;
+    unsigned long count;
+} batch_chunk;
+
+typedef struct
+{
+    batch_chunk * chunks;
+    unsigned long chunk_count;
+    unsigned long next;
+    uint64_t      in_flight; /* Input bytes of chunks being converted */
+    uint64_t      budget;
+    unsigned long failed;
+    mutex         lock;
+    condition     changed;
+} batch_queue;
+
+/* Record the first error of a job
+   Note: Must be called with the queue locked */
+void batch_fail(batch_job * job, const char * msg, const char * detail)
+{
+    if (!job->failed)
+    {
+        job->failed = 1;
+        sprintf(job->error, "%.200s: %.200s", msg, detail);
+    }
+}
+
+/* Sort jobs largest first */
+int batch_compare(const void * a, const void * b)
+{
+    const batch_job * x;
+    const batch_job * y;
+
+    x = (const batch_job *)a;
+    y = (const batch_job *)b;
+
+    return (x->sectors < y->sectors) ? 1 : (x->sectors > y->sectors) ? -1 : 0;
+}
+
+/* Convert one sector of a chunk, returns 0 on success or fills msg and
+   detail
+   Note: msg may point to where (at least 64 bytes) to name the sector */
+int batch_convert_sector(const batch_chunk * chunk,
+                         unsigned long       sector_num,
+                         const void *        sector,
+                         FILE *              out,
+                         char *              where,
+                         const char **       msg,
+                         const char **       detail)
+{
+    const void * data;
+    sector_mode  mode;
+    sector_error error;
+
+    error = sector_analyze(sector, &data, &mode);
+
+    if (error == SECTOR_ERROR_MODE_2_F1_AMBIGUOUS ||
+        error == SECTOR_ERROR_MODE_2_F2_AMBIGUOUS)
+    {
+        printf("Warning: %s: sector_analyze_sector(%lu): %s\n",
+               chunk->job->in_name,
+               sector_num,
+               sector_error_string(error));
+    }
+    else if (error)
+    {
+        sprintf(where, "sector_analyze_sector(%lu)", sector_num);
+
+        *msg    = where;
+        *detail = sector_error_string(error);
+
+        return -1;
+    }
+
+    if (mode != SECTOR_MODE_1 && mode != SECTOR_MODE_2_FORM_1)
+    {
+        sprintf(where,
+                "sector_analyze_sector(%lu): Non-data sector",
+                sector_num);
+
+        *msg    = where;
+        *detail = sector_mode_string(mode);
+
+        return -1;
+    }
+
+    if (fwrite(data, 2048, 1, out) != 1)
+    {
+        *msg    = "Error writing output file";
+        *detail = strerror(errno);
+
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Convert one chunk, returns 0 on success or fills msg and detail
+   Notes:
+   - Header address anomalies are counted in *address_errors
+   - msg may point to where (at least 64 bytes) */
+int batch_convert(const batch_chunk * chunk,
+                  unsigned long *     address_errors,
+                  char *              where,
+                  const char **       msg,
+                  const char **       detail)
+{
+    FILE *               in;
+    FILE *               out;
+    char *               buffer;
+    sector_address_check check;
+    unsigned long        sector_num;
+    unsigned long        count;
+    int                  result;
+
+    *detail = "";
+
+    if ((!(buffer = (char *)malloc(BATCH_READ_SECTORS * 2352))))
+    {
+        *msg    = "Error allocating memory";
+        *detail = strerror(errno);
+
+        return -1;
+    }
+
+    if ((!(in = fopen(chunk->job->in_name, "rb"))))
+    {
+        *msg    = "Error opening input file";
+        *detail = strerror(errno);
+
+        free(buffer);
+
+        return -1;
+    }
+
+    if ((!(out = fopen(chunk->job->out_name, "r+b"))))
+    {
+        *msg    = "Error opening output file";
+        *detail = strerror(errno);
+
+        fclose(in);
+        free(buffer);
+
+        return -1;
+    }
+
+    result = 0;
+
+    sector_address_check_init(&check);
+
+    /* Seed the address check with the sectors preceding the chunk so that
+       anomalies on chunk boundaries are found as in a sequential pass, the
+       first one sets the baseline so it should be well clear of the boundary */
+    count = chunk->first < BATCH_SEED_SECTORS ? chunk->first
+                                              : BATCH_SEED_SECTORS;
+
+    if (count)
+    {
+        sector_address_status status;
+        uint32_t              checked;
+
+        if (fileio_seek(in, (uint64_t)(chunk->first - count) * 2352) ||
+            fread(buffer, 2352, count, in) != count)
+        {
+            *msg    = "Error reading input file";
+            *detail = ferror(in) ? strerror(errno) : "Unexpected end of file";
+            result  = -1;
+        }
+
+        /* Anomalies here belong to the previous chunk, reading them left
+           the input positioned at the chunk */
+        for (checked = 0; !result && checked < count;)
+        {
+            checked += sector_address_check_sectors(
+                &check,
+                &buffer[checked * 2352],
+                (uint32_t)(chunk->first - count + checked),
+                (uint32_t)(count - checked),
+                &status);
+        }
+    }
+
+    if (!result && fileio_seek(out, (uint64_t)chunk->first * 2048))
+    {
+        *msg    = "Error seeking";
+        *detail = strerror(errno);
+        result  = -1;
+    }
+
+    for (sector_num = chunk->first;
+         !result && sector_num < chunk->first + chunk->count;
+         sector_num += count)
+    {
+        sector_address_status status;
+        uint32_t              checked;
+        unsigned long         i;
+
+        count = chunk->first + chunk->count - sector_num;
+
+        if (count > BATCH_READ_SECTORS)
+        {
+            count = BATCH_READ_SECTORS;
+        }
+
+        if (fread(buffer, 2352, count, in) != count)
+        {
+            *msg    = "Error reading input file";
+            *detail = ferror(in) ? strerror(errno) : "Unexpected end of file";
+            result  = -1;
+
+            break;
+        }
+
+        /* Check header addresses of the whole block in one pass */
+        for (i = 0; i < count; i += checked)
+        {
+            checked = sector_address_check_sectors(&check,
+                                                   &buffer[i * 2352],
+                                                   (uint32_t)(sector_num + i),
+                                                   (uint32_t)(count - i),
+                                                   &status);
+
+            if (status)
+            {
+                address_warning(chunk->job->in_name,
+                                sector_num + i + checked - 1,
+                                &buffer[(i + checked - 1) * 2352],
+                                status,
+                                address_errors);
+            }
+        }
+
+        for (i = 0; !result && i < count; i++)
+        {
+            result = batch_convert_sector(chunk,
+                                          sector_num + i,
+                                          &buffer[i * 2352],
+                                          out,
+                                          where,
+                                          msg,
+                                          detail);
+        }
+    }
+
+    fclose(in);
+    free(buffer);
+
+    if (fclose(out) != 0 && !result)
+    {
+        *msg    = "Error writing output file";
+        *detail = strerror(errno);
+        result  = -1;
+    }
+
+    return result;
+}
+
+/* Worker: take chunks in order while the in-flight budget allows */
+THREAD_FUNCTION(batch_worker)
+{
+    batch_queue * queue;
+
+    queue = (batch_queue *)arg;
+
+    mutex_lock(&queue->lock);
+
+    for (;;)
+    {
+        batch_chunk * chunk;
+        uint64_t      bytes;
+        unsigned long address_errors;
+        char          where[64];
+        const char *  msg;
+        const char *  detail;
+        int           result;
+
+        if (queue->next == queue->chunk_count)
+        {
+            break;
+        }
+
+        chunk = &queue->chunks[queue->next];
+        bytes = (uint64_t)chunk->count * 2352; /* Input still to be read */
+
+        /* Always let one chunk through so oversized chunks cannot stall */
+        if (queue->in_flight && queue->in_flight + bytes > queue->budget)
+        {
+            condition_wait(&queue->changed, &queue->lock);
+
+            continue;
+        }
+
+        queue->next++;
+        queue->in_flight += bytes;
+
+        result         = 0;
+        address_errors = 0;
+
+        if (!chunk->job->failed)
+        {
+            mutex_unlock(&queue->lock);
+            result = batch_convert(chunk,
+                                   &address_errors,
+                                   &where[0],
+                                   &msg,
+                                   &detail);
+            mutex_lock(&queue->lock);
+        }
+
+        chunk->job->address_errors += address_errors;
+
+        if (result)
+        {
+            batch_fail(chunk->job, msg, detail);
+        }
+
+        if (--chunk->job->chunks_left == 0)
+        {
+            if (chunk->job->failed)
+            {
+                fprintf(stderr,
+                        "Error: %s: %s\n",
+                        chunk->job->in_name,
+                        chunk->job->error);
+
+                queue->failed++;
+            }
+            else
+            {
+                printf("Converted %s (%lu sectors)\n",
+                       chunk->job->in_name,
+                       chunk->job->sectors);
+
+                if (chunk->job->address_errors)
+                {
+                    printf("Warning: %s: %lu header address errors\n",
+                           chunk->job->in_name,
+                           chunk->job->address_errors);
+                }
+            }
+        }
+
+        queue->in_flight -= bytes;
+        condition_broadcast(&queue->changed);
+    }
+
+    mutex_unlock(&queue->lock);
+
+    return 0;
+}
+
+/* Read manifest, size and create outputs, then run the worker pool
+   Returns the number of failed jobs */
+unsigned long batch(const char * manifest_name,
+                    unsigned     threads,
+                    uint64_t     budget)
+{
+    FILE *        manifest;
+    batch_job *   jobs;
+    unsigned long job_count;
+    unsigned long job_capacity;
+    batch_queue   queue;
+    thread        workers[BATCH_MAX_THREADS];
+    char          line[4096];
+    unsigned long i;
+    unsigned      t;
+
+    if ((!(manifest = fopen(manifest_name, "r"))))
+    {
+        perror_exit("Error opening manifest file");
+    }
+
+    jobs         = NULL;
+    job_count    = 0;
+    job_capacity = 0;
+
+    memset(&queue, 0, sizeof(queue));
+
+    /* Parse "<input><TAB><output>" lines, a space works if names have none */
+    while (fgets(line, sizeof(line), manifest))
+    {
+        char *      split;
+        batch_job * job;
+
+        line[strcspn(line, "\r\n")] = '\0';
+
+        if (!line[0])
+        {
+            continue;
+        }
+
+        if ((!(split = strchr(line, '\t'))) && (!(split = strchr(line, ' '))))
+        {
+            fprintf(stderr, "Error: Invalid manifest line: %s\n", line);
+
+            exit(1);
+        }
+
+        *split++ = '\0';
+
+        if (job_count == job_capacity)
+        {
+            job_capacity = job_capacity ? job_capacity * 2 : 64;
+
+            if ((!(jobs = (batch_job *)realloc(jobs,
+                                               job_capacity *
+                                                   sizeof(batch_job)))))
+            {
+                perror_exit("Error allocating memory");
+            }
+        }
+
+        job = &jobs[job_count++];
+
+        memset(job, 0, sizeof(*job));
+
+        if ((!(job->in_name = (char *)malloc(strlen(line) + 1))) ||
+            (!(job->out_name = (char *)malloc(strlen(split) + 1))))
+        {
+            perror_exit("Error allocating memory");
+        }
+
+        strcpy(job->in_name, line);
+        strcpy(job->out_name, split);
+    }
+
+    if (ferror(manifest))
+    {
+        perror_exit("Error reading manifest file");
+    }
+
+    fclose(manifest);
+
+    /* Size inputs and create outputs so chunks can be written in any order */
+    for (i = 0; i < job_count; i++)
+    {
+        FILE *   f;
+        uint64_t size;
+
+        if ((!(f = fopen(jobs[i].in_name, "rb"))) || fileio_size(f, &size))
+        {
+            batch_fail(&jobs[i], "Error opening input file", strerror(errno));
+
+            if (f) fclose(f);
+
+            continue;
+        }
+
+        fclose(f);
+
+        if (size % 2352 != 0)
+        {
+            batch_fail(&jobs[i],
+                       "Error",
+                       "Input file size not divisible by 2352");
+
+            continue;
+        }
+
+        jobs[i].sectors = (unsigned long)(size / 2352);
+
+        if ((!(f = fopen(jobs[i].out_name, "wb"))))
+        {
+            batch_fail(&jobs[i], "Error opening output file", strerror(errno));
+
+            continue;
+        }
+
+        fclose(f);
+    }
+
+    qsort(jobs, job_count, sizeof(batch_job), batch_compare);
+
+    /* Split jobs into chunks, largest job first */
+    for (i = 0; i < job_count; i++)
+    {
+        if (jobs[i].failed)
+        {
+            fprintf(stderr, "Error: %s: %s\n", jobs[i].in_name, jobs[i].error);
+
+            queue.failed++;
+
+            continue;
+        }
+
+        queue.chunk_count +=
+            (jobs[i].sectors + BATCH_CHUNK_SECTORS - 1) / BATCH_CHUNK_SECTORS;
+
+        if (!jobs[i].sectors)
+        {
+            printf("Converted %s (0 sectors)\n", jobs[i].in_name);
+        }
+    }
+
+    if ((!(queue.chunks = (batch_chunk *)malloc(
+              (queue.chunk_count + 1) * sizeof(batch_chunk)))))
+    {
+        perror_exit("Error allocating memory");
+    }
+
+    queue.chunk_count = 0;
+
+    for (i = 0; i < job_count; i++)
+    {
+        unsigned long first;
+
+        if (jobs[i].failed)
+        {
+            continue;
+        }
+
+        for (first = 0; first < jobs[i].sectors; first += BATCH_CHUNK_SECTORS)
+        {
+            batch_chunk * chunk;
+
+            chunk        = &queue.chunks[queue.chunk_count++];
+            chunk->job   = &jobs[i];
+            chunk->first = first;
+            chunk->count = jobs[i].sectors - first;
+
+            if (chunk->count > BATCH_CHUNK_SECTORS)
+            {
+                chunk->count = BATCH_CHUNK_SECTORS;
+            }
+
+            jobs[i].chunks_left++;
+        }
+    }
+
+    queue.budget = budget;
+
+    mutex_init(&queue.lock);
+    condition_init(&queue.changed);
+
+    for (t = 0; t < threads; t++)
+    {
+        if (thread_create(&workers[t], batch_worker, &queue) != 0)
+        {
+            fprintf(stderr, "Error: Unable to create worker thread\n");
+
+            exit(1);
+        }
+    }
+
+    for (t = 0; t < threads; t++)
+    {
+        thread_join(workers[t]);
+    }
+
+    condition_destroy(&queue.changed);
+    mutex_destroy(&queue.lock);
+
+    for (i = 0; i < job_count; i++)
+    {
+        free(jobs[i].in_name);
+        free(jobs[i].out_name);
+    }
+
+    free(jobs);
+    free(queue.chunks);
+
+    return queue.failed;
+}
+
+/*******************************************************************************
+Conversion
+*******************************************************************************/
+#define CONVERT_BUFFER_SIZE (1024 * 1024)
+
+typedef struct
+{
+    FILE *               out;
+    const char *         in_name;
+    const char *         out_name;
+    demux_stream *       streams;
+    int                  hash;
+    digest               raw_digest;
+    digest               data_digest;
+    digest               track_raw_digest; /* Only with a cue sheet */
+    digest               track_data_digest;
+    unsigned long        skipped;
+    const char *         audio_prefix; /* NULL skips audio sectors */
+    audio_track          audio;
+    unsigned long        audio_skipped;
+    cue_track            tracks[CUE_MAX_TRACKS];
+    unsigned             track_count; /* Zero means no cue sheet */
+    unsigned             track_index;
+    sector_address_check address_check;
+    unsigned long        address_errors;
+} convert_state;
+
+/* Hash payload into the image and, with a cue sheet, the track digests */
+void convert_hash(convert_state * state, const void * data, unsigned size)
+{
+    digest_update(&state->data_digest, data, size);
+
+    if (state->track_count)
+    {
+        digest_update(&state->track_data_digest, data, size);
+    }
+}
+
+/* Print the current track's digests and reset them for the next track
+   Note: The payload of an audio track is its raw sectors */
+void convert_track_digests(convert_state * state)
+{
+    const cue_track * track;
+    digest_result     result;
+    char              str[83];
+
+    track = &state->tracks[state->track_index];
+
+    digest_final(&state->track_raw_digest, &result);
+    digest_string(&result, &str[0]);
+    printf("Track %02u raw:  %s\n", track->number, str);
+
+    if (!track->audio)
+    {
+        digest_final(&state->track_data_digest, &result);
+        digest_string(&result, &str[0]);
+    }
+
+    printf("Track %02u data: %s\n", track->number, str);
+
+    digest_init(&state->track_raw_digest);
+    digest_init(&state->track_data_digest);
+}
+
+/* Route a CD-DA sector to its track's output, returns 0 on success */
+int convert_audio(convert_state * state, const void * sector, unsigned track)
+{
+    if (!state->audio_prefix)
+    {
+        state->audio_skipped++;
+
+        return 0;
+    }
+
+    if (state->audio.out && state->audio.number != track)
+    {
+        if (audio_close(&state->audio))
+        {
+            return -1;
+        }
+    }
+
+    if (!state->audio.out &&
+        audio_open(&state->audio, state->audio_prefix, track))
+    {
+        return -1;
+    }
+
+    if (fwrite(sector, 2352, 1, state->audio.out) != 1)
+    {
+        perror("Error writing audio output file");
+
+        return -1;
+    }
+
+    state->audio.sectors++;
+
+    return 0;
+}
+
+/* Stream callback: write one sector's data to the .iso or a demux stream */
+int convert_sector(void *       user,
+                   uint32_t     sector_num,
+                   const void * sector,
+                   sector_error error,
+                   sector_mode  mode,
+                   const void * data)
+{
+    convert_state *       state;
+    sector_address_status status;
+
+    state = (convert_state *)user;
+
+    if (state->hash) digest_update(&state->raw_digest, sector, 2352);
+
+    /* Sectors without sync (CD-DA) are ignored by the check */
+    if ((status = sector_address_check_sector(&state->address_check,
+                                              sector,
+                                              sector_num)) >
+        SECTOR_ADDRESS_NONE)
+    {
+        address_warning(state->in_name,
+                        sector_num,
+                        sector,
+                        status,
+                        &state->address_errors);
+    }
+
+    /* Classify CD-DA by cue sheet track type only, a missing sync inside a
+       data track is damage and must stop the conversion */
+    if (state->track_count)
+    {
+        while (state->track_index + 1 < state->track_count &&
+               sector_num >= state->tracks[state->track_index + 1].start)
+        {
+            if (state->hash) convert_track_digests(state);
+
+            state->track_index++;
+        }
+
+        if (state->hash)
+        {
+            digest_update(&state->track_raw_digest, sector, 2352);
+        }
+
+        if (state->tracks[state->track_index].audio)
+        {
+            return convert_audio(state,
+                                 sector,
+                                 state->tracks[state->track_index].number)
+                       ? 1
+                       : 0;
+        }
+    }
+
+    /* Form 2 EDC is optional, a stored zero means it was never computed */
+    if (error == SECTOR_ERROR_MODE_2_F2_AMBIGUOUS &&
+        ((const sector_mode_2_form_2 *)sector)->edc == 0)
+    {
+        error = SECTOR_ERROR_NONE;
+    }
+
+    if (error)
+    {
+        if (error == SECTOR_ERROR_MODE_2_F1_AMBIGUOUS ||
+            error == SECTOR_ERROR_MODE_2_F2_AMBIGUOUS)
+        {
+            printf("Warning: sector_analyze_sector(%lu): %s\n",
+                   (unsigned long)sector_num,
+                   sector_error_string(error));
+        }
+        else
+        {
+            fprintf(stderr,
+                    "Error: sector_analyze_sector(%lu): %s\n",
+                    (unsigned long)sector_num,
+                    sector_error_string(error));
+
+            return 1;
+        }
+    }
+
+    if (state->streams)
+    {
+        /* Route XA payloads by subheader, skip everything else */
+        if (mode == SECTOR_MODE_2_FORM_1 || mode == SECTOR_MODE_2_FORM_2)
+        {
+            demux_stream * stream;
+            unsigned       size;
+
+            if ((!(stream = demux_open(state->streams,
+                                       state->out_name,
+                                       (const uint8_t *)sector + 16))))
+            {
+                return 1;
+            }
+
+            /* Form 2 keeps the subheader (and EDC), XA ADPCM decoders need
+               its coding info for sample rate, channels and bit depth */
+            if (mode == SECTOR_MODE_2_FORM_2)
+            {
+                data = (const uint8_t *)sector + 16;
+                size = 2336;
+            }
+            else
+            {
+                size = 2048;
+            }
+
+            if (fwrite(data, size, 1, stream->out) != 1)
+            {
+                perror("Error writing output file");
+
+                return 1;
+            }
+
+            stream->sectors++;
+
+            if (state->hash) convert_hash(state, data, size);
+        }
+        else
+        {
+            state->skipped++;
+        }
+    }
+    else
+    {
+        if (mode != SECTOR_MODE_1 && mode != SECTOR_MODE_2_FORM_1)
+        {
+            fprintf(stderr,
+                    "Error: sector_analyze_sector(%lu): "
+                    "Non-data sector: %s\n",
+                    (unsigned long)sector_num,
+                    sector_mode_string(mode));
+
+            return 1;
+        }
+
+        if (fwrite(data, 2048, 1, state->out) != 1)
+        {
+            perror("Error writing output file");
+
+            return 1;
+        }
+
+        if (state->hash) convert_hash(state, data, 2048);
+    }
+
+    return 0;
+}
+
+/*******************************************************************************
+main()
+*******************************************************************************/
+int main(int argc, const char ** argv)
+{
+    FILE *        in;
+    convert_state state;
+    int           i;
+
+    memset(&state, 0, sizeof(state));
+
+    /* Batch mode */
+    if (argc >= 3 && strcmp(argv[1], "-b") == 0)
+    {
+        unsigned long threads;
+        unsigned long budget;
+
+        threads = 4;
+        budget  = 128;
+
+        for (i = 2; i < argc - 1; i += 2)
+        {
+            if (strcmp(argv[i], "-j") == 0)
+            {
+                threads = strtoul(argv[i + 1], NULL, 10);
+            }
+            else if (strcmp(argv[i], "-m") == 0)
+            {
+                budget = strtoul(argv[i + 1], NULL, 10);
+            }
+            else
+            {
+                help_exit(argv[0]);
+            }
+        }
+
+        if (i != argc - 1 || threads < 1 || threads > BATCH_MAX_THREADS ||
+            budget < 1 || budget > 4095)
+        {
+            help_exit(argv[0]);
+        }
+
+        return batch(argv[argc - 1], (unsigned)threads, (uint64_t)budget << 20)
+                   ? 1
+                   : 0;
+    }
+
+    /* Check args */
+    for (i = 1; i < argc - 2 && argv[i][0] == '-'; i++)
+    {
+        if (strcmp(argv[i], "-d") == 0)
+        {
+            state.hash = 1;
+        }
+        else if (strcmp(argv[i], "-a") == 0 && i < argc - 3)
+        {
+            state.audio_prefix = argv[++i];
+        }
+        else if (strcmp(argv[i], "-c") == 0 && i < argc - 3)
+        {
+            state.track_count = cue_read(argv[++i], &state.tracks[0]);
+        }
+        else if (strcmp(argv[i], "-x") == 0 && !state.streams)
+        {
+            if ((!(state.streams = (demux_stream *)
+                       calloc(DEMUX_STREAMS, sizeof(demux_stream)))))
+            {
+                perror_exit("Error allocating memory");
+            }
+        }
+        else
+        {
+            help_exit(argv[0]);
+        }
+    }
+
+    /* Audio is only classified within cue sheet track boundaries */
+    if (argc < 3 || i != argc - 2 || (state.audio_prefix && !state.track_count))
+    {
+        help_exit(argv[0]);
+    }
+
+    state.in_name  = argv[argc - 2];
+    state.out_name = argv[argc - 1];
+
+    /* Open input file */
+    if ((!(in = fopen(state.in_name, "rb"))))
+    {
+        perror_exit("Error opening input file");
+    }
+
+    /* Check that the input file size is divisible by 2352 */
+    {
+        uint64_t in_size;
+
+        if (fileio_size(in, &in_size))
+        {
+            perror_exit("Error determining size of input file");
+        }
+
+        if (in_size % 2352 != 0)
+        {
+            fprintf(stderr, "Error: Input file size not divisible by 2352\n");
+
+            exit(1);
+        }
+    }
+
+    /* Open output file, demux streams are opened as they are found */
+    if (!state.streams && (!(state.out = fopen(state.out_name, "wb"))))
+    {
+        perror_exit("Error opening output file");
+    }
+
+    digest_init(&state.raw_digest);
+    digest_init(&state.data_digest);
+    digest_init(&state.track_raw_digest);
+    digest_init(&state.track_data_digest);
+    sector_address_check_init(&state.address_check);
+
+    /* Push the image through the streaming decoder in large reads */
+    {
+        sector_stream stream;
+        sector_error  error;
+        char *        buffer;
+        size_t        size;
+
+        if ((!(buffer = (char *)malloc(CONVERT_BUFFER_SIZE))))
+        {
+            perror_exit("Error allocating memory");
+        }
+
+        sector_stream_init(&stream, convert_sector, &state);
+
+        while ((size = fread(buffer, 1, CONVERT_BUFFER_SIZE, in)) != 0)
+        {
+            if (sector_stream_push(&stream, buffer, size))
+            {
+                exit(1);
+            }
+        }
+
+        if (ferror(in))
+        {
+            perror_exit("Error reading input file");
+        }
+
+        if ((error = sector_stream_finish(&stream)))
+        {
+            fprintf(stderr, "Error: %s\n", sector_error_string(error));
+
+            exit(1);
+        }
+
+        if (audio_close(&state.audio))
+        {
+            exit(1);
+        }
+
+        free(buffer);
+    }
+
+    /* Print digests, tracks not reached by the image are still listed */
+    if (state.hash)
+    {
+        digest_result result;
+        char          str[83];
+
+        while (state.track_count)
+        {
+            convert_track_digests(&state);
+
+            if (++state.track_index == state.track_count)
+            {
+                break;
+            }
+        }
+
+        digest_final(&state.raw_digest, &result);
+        digest_string(&result, &str[0]);
+        printf("Raw:  %s\n", str);
+
+        digest_final(&state.data_digest, &result);
+        digest_string(&result, &str[0]);
+        printf("Data: %s\n", str);
+    }
+
+    /* Cleanup */
+    fclose(in);
+
+    if (state.streams)
+    {
+        if (demux_close(state.streams))
+        {
+            exit(1);
+        }
+
+        free(state.streams);
+
+        if (state.skipped)
+        {
+            printf("Skipped %lu non-XA sectors\n", state.skipped);
+        }
+    }
+    else if (fclose(state.out) != 0)
+    {
+        perror_exit("Error writing output file");
+    }
+
+    if (state.audio_skipped)
+    {
+        printf("Skipped %lu audio sectors\n", state.audio_skipped);
+    }
+
+    if (state.address_errors)
+    {
+        printf("Warning: %lu header address errors\n", state.address_errors);
+    }
 
     return 0;
 }
@@ -0,0 +1,860 @@
+/*******************************************************************************
+ * Sector level .bin diff and patch using CD-ROM Sector Library
+ * Copyright (C) 2026 Aaron Clovsky
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/*
+    Patch format (integers are 32 bit little-endian):
+
+    "BINPTCH1" <old sectors> <new sectors> <new image SHA-1, 20 bytes>
+    Followed by records until every new sector has been produced:
+    - 'S' <count>: Copy raw sectors from the old image at the same position
+    - 'C' <count> <old sector> <mode> <offset> <sub header>:
+      Regenerate sectors from user data at consecutive old sectors
+    - 'D' <count> <mode> <offset> <sub header> <user data...>:
+      Regenerate sectors from literal user data
+    - 'R' <count> <raw sectors...>: Literal 2352 byte sectors
+
+    <mode> is one byte, <offset> is the 3 byte BCD header address of the
+    first sector (incremented per sector) and <sub header> is 8 bytes.
+
+    Sync, header, EDC and ECC are never stored, the diff only uses 'C' and
+    'D' for sectors which regenerate bit-exactly and falls back to 'R'.
+*/
+
+/*******************************************************************************
+Headers
+*******************************************************************************/
+#include <sector.h>
+#include <digest.h>
+#include <fileio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*******************************************************************************
+Constants
+*******************************************************************************/
+#define PATCH_MAGIC       "BINPTCH1"
+#define PATCH_MAX_LITERAL 256 /* Sectors buffered per 'D'/'R' record */
+
+/*******************************************************************************
+Types
+*******************************************************************************/
+/* Old image user data index entry */
+typedef struct
+{
+    uint32_t hash;
+    uint32_t sector; /* Old sector number + 1, zero marks an empty slot */
+} index_entry;
+
+/* Pending record */
+typedef struct
+{
+    char      op; /* Zero when nothing is pending */
+    uint32_t  count;
+    uint32_t  source;
+    uint8_t   mode;
+    uint8_t   offset[3];
+    uint8_t   next_offset[3];
+    uint8_t   sub_header[8];
+    uint8_t * literal;
+    size_t    literal_size;
+} record;
+
+/* Sector split into regeneration parameters */
+typedef struct
+{
+    sector_mode     mode; /* SECTOR_MODE_INVALID if not regenerable */
+    const uint8_t * data;
+    unsigned        size;
+    uint8_t         sub_header[8];
+} sector_info;
+
+/*******************************************************************************
+Utilities
+*******************************************************************************/
+/* Print error and exit */
+void perror_exit(const char * msg)
+{
+    perror(msg);
+
+    exit(1);
+}
+
+/* Print error and exit */
+void error_exit(const char * msg)
+{
+    fprintf(stderr, "Error: %s\n", msg);
+
+    exit(1);
+}
+
+/* Print help and exit */
+void help_exit(const char * arg)
+{
+    const char * name;
+
+    if ((!(name = strrchr(arg, '/'))))
+    {
+        name = strrchr(arg, '\\');
+    }
+
+    name = name ? &name[1] : arg;
+
+    printf("Usage: %s diff <old .bin> <new .bin> <output patch>\n"
+           "       %s apply <old .bin> <patch> <output .bin>\n",
+           name,
+           name);
+
+    exit(2);
+}
+
+/* Allocate or exit */
+void * xmalloc(size_t size)
+{
+    void * p;
+
+    if ((!(p = malloc(size))))
+    {
+        error_exit("Out of memory");
+    }
+
+    return p;
+}
+
+/* Read one sector at an index, seeking only when not already there */
+int read_sector(FILE * f, unsigned long * pos, unsigned long index, void * buf)
+{
+    if (*pos != index)
+    {
+        if (fileio_seek(f, (uint64_t)index * 2352))
+        {
+            perror_exit("Error seeking input file");
+        }
+
+        *pos = index;
+    }
+
+    if (fread(buf, 2352, 1, f) != 1)
+    {
+        *pos = (unsigned long)-1;
+
+        return 0;
+    }
+
+    (*pos)++;
+
+    return 1;
+}
+
+/* Number of whole sectors in a file */
+unsigned long sector_count(FILE * f)
+{
+    uint64_t size;
+
+    if (fileio_size(f, &size))
+    {
+        perror_exit("Error determining size of input file");
+    }
+
+    if (size % 2352 != 0)
+    {
+        error_exit("Input file size not divisible by 2352");
+    }
+
+    /* The patch format stores sector counts in 32 bits */
+    if (size / 2352 > 0xffffffff)
+    {
+        error_exit("Input file too large");
+    }
+
+    return (unsigned long)(size / 2352);
+}
+
+/* Write a 32 bit little-endian integer */
+void put_u32(uint8_t * p, uint32_t value)
+{
+    p[0] = (uint8_t)(value);
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+}
+
+/* Read a 32 bit little-endian integer */
+uint32_t get_u32(const uint8_t * p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+           (uint32_t)p[3] << 24;
+}
+
+/* Write or exit */
+void xwrite(const void * data, size_t size, FILE * f)
+{
+    if (size && fwrite(data, size, 1, f) != 1)
+    {
+        perror_exit("Error writing output file");
+    }
+}
+
+/* Read or exit */
+void xread(void * data, size_t size, FILE * f)
+{
+    if (size && fread(data, size, 1, f) != 1)
+    {
+        error_exit("Patch file truncated");
+    }
+}
+
+/* FNV-1a hash of user data */
+uint32_t data_hash(const uint8_t * data, unsigned size)
+{
+    uint32_t h;
+
+    h = 2166136261u;
+
+    while (size--)
+    {
+        h = (h ^ *data++) * 16777619u;
+    }
+
+    return h;
+}
+
+/* Locate user data and check whether the sector regenerates bit-exactly */
+void sector_split(const uint8_t * sector, sector_info * info, int verify)
+{
+    sector_error error;
+    const void * data;
+    sector_mode  mode;
+    uint8_t      rebuilt[2352];
+
+    error = sector_analyze(sector, &data, &mode);
+
+    memset(&info->sub_header[0], 0, 8);
+
+    if (error == SECTOR_ERROR_INVALID_SYNC ||
+        error == SECTOR_ERROR_INVALID_MODE)
+    {
+        info->mode = SECTOR_MODE_INVALID;
+
+        return;
+    }
+
+    if (mode == SECTOR_MODE_2_FORM_1 || mode == SECTOR_MODE_2_FORM_2)
+    {
+        memcpy(&info->sub_header[0], &sector[16], 8);
+    }
+
+    info->mode = mode;
+    info->data = (const uint8_t *)data;
+    info->size = sector_data_size(mode);
+
+    if (verify)
+    {
+        sector_encode(&rebuilt[0],
+                      &((const sector_header *)sector)->offset[0],
+                      mode,
+                      &info->sub_header[0],
+                      data);
+
+        if (memcmp(&rebuilt[0], sector, 2352) != 0)
+        {
+            info->mode = SECTOR_MODE_INVALID;
+        }
+    }
+}
+
+/*******************************************************************************
+diff
+*******************************************************************************/
+/* Write the pending record, if any */
+void record_flush(record * r, FILE * out)
+{
+    uint8_t buf[21];
+    size_t  size;
+
+    if (!r->op)
+    {
+        return;
+    }
+
+    buf[0] = (uint8_t)r->op;
+    put_u32(&buf[1], r->count);
+    size = 5;
+
+    if (r->op == 'C')
+    {
+        put_u32(&buf[size], r->source);
+        size += 4;
+    }
+
+    if (r->op == 'C' || r->op == 'D')
+    {
+        buf[size++] = r->mode;
+        memcpy(&buf[size], &r->offset[0], 3);
+        memcpy(&buf[size + 3], &r->sub_header[0], 8);
+        size += 11;
+    }
+
+    xwrite(&buf[0], size, out);
+    xwrite(r->literal, r->literal_size, out);
+
+    r->op           = 0;
+    r->literal_size = 0;
+}
+
+/* Try to extend the pending record, returns 0 if a new one is needed */
+int record_extend(record *              r,
+                  char                  op,
+                  uint32_t              source,
+                  const sector_header * header,
+                  const sector_info *   info)
+{
+    if (r->op != op)
+    {
+        return 0;
+    }
+
+    if (op == 'S')
+    {
+        r->count++;
+
+        return 1;
+    }
+
+    if ((op == 'D' || op == 'R') && r->count == PATCH_MAX_LITERAL)
+    {
+        return 0;
+    }
+
+    if (op == 'C' && source != r->source + r->count)
+    {
+        return 0;
+    }
+
+    if ((op == 'C' || op == 'D') &&
+        (r->mode != (uint8_t)info->mode ||
+         memcmp(&r->next_offset[0], &header->offset[0], 3) != 0 ||
+         memcmp(&r->sub_header[0], &info->sub_header[0], 8) != 0))
+    {
+        return 0;
+    }
+
+    r->count++;
+
+    return 1;
+}
+
+/* Add one new sector to the patch */
+void record_add(record *            r,
+                char                op,
+                uint32_t            source,
+                const uint8_t *     sector,
+                const sector_info * info,
+                FILE *              out)
+{
+    const sector_header * header;
+
+    header = (const sector_header *)sector;
+
+    if (!record_extend(r, op, source, header, info))
+    {
+        record_flush(r, out);
+
+        r->op     = op;
+        r->count  = 1;
+        r->source = source;
+
+        if (op == 'C' || op == 'D')
+        {
+            r->mode = (uint8_t)info->mode;
+            memcpy(&r->offset[0], &header->offset[0], 3);
+            memcpy(&r->sub_header[0], &info->sub_header[0], 8);
+        }
+    }
+
+    if (op == 'C' || op == 'D')
+    {
+        if (!sector_offset_next(&header->offset[0], &r->next_offset[0]))
+        {
+            /* Force the next sector into a new record */
+            memset(&r->next_offset[0], 0xff, 3);
+        }
+    }
+
+    if (op == 'D')
+    {
+        memcpy(&r->literal[r->literal_size], info->data, info->size);
+        r->literal_size += info->size;
+    }
+    else if (op == 'R')
+    {
+        memcpy(&r->literal[r->literal_size], sector, 2352);
+        r->literal_size += 2352;
+    }
+}
+
+/* Find old sector holding the same user data, returns old sector + 1 or 0 */
+uint32_t index_find(const index_entry * table,
+                    uint32_t            mask,
+                    FILE *              old,
+                    unsigned long *     old_pos,
+                    const sector_info * info)
+{
+    uint32_t hash;
+    uint32_t slot;
+    uint8_t  sector[2352];
+
+    hash = data_hash(info->data, info->size);
+
+    for (slot = hash & mask; table[slot].sector; slot = (slot + 1) & mask)
+    {
+        sector_info candidate;
+
+        if (table[slot].hash != hash)
+        {
+            continue;
+        }
+
+        if (!read_sector(old, old_pos, table[slot].sector - 1, &sector[0]))
+        {
+            perror_exit("Error reading input file");
+        }
+
+        sector_split(&sector[0], &candidate, 0);
+
+        if (candidate.mode != SECTOR_MODE_INVALID &&
+            candidate.size == info->size &&
+            memcmp(candidate.data, info->data, info->size) == 0)
+        {
+            return table[slot].sector;
+        }
+    }
+
+    return 0;
+}
+
+/* Compare images and write a patch of changed user data */
+void diff(const char * old_name, const char * new_name, const char * out_name)
+{
+    FILE *        old_seq;
+    FILE *        old_rand;
+    FILE *        in;
+    FILE *        out;
+    unsigned long old_count;
+    unsigned long new_count;
+    unsigned long old_pos;
+    index_entry * table;
+    uint32_t      mask;
+    record        r;
+    digest        image;
+    digest_result result;
+    uint8_t       old_sector[2352];
+    uint8_t       new_sector[2352];
+    unsigned long i;
+    unsigned long stats[4];
+
+    if ((!(old_seq = fopen(old_name, "rb"))) ||
+        (!(old_rand = fopen(old_name, "rb"))))
+    {
+        perror_exit("Error opening old input file");
+    }
+
+    if ((!(in = fopen(new_name, "rb"))))
+    {
+        perror_exit("Error opening new input file");
+    }
+
+    old_count = sector_count(old_seq);
+    new_count = sector_count(in);
+
+    /* Index old user data by hash (open addressing, load <= 50%) */
+    for (mask = 1; mask < old_count * 2; mask <<= 1)
+    {
+    }
+
+    table = (index_entry *)xmalloc(mask * sizeof(index_entry));
+    memset(table, 0, mask * sizeof(index_entry));
+    mask--;
+
+    old_pos = (unsigned long)-1;
+
+    for (i = 0; i < old_count; i++)
+    {
+        sector_info info;
+        uint32_t    hash;
+        uint32_t    slot;
+
+        if (fread(&old_sector[0], 2352, 1, old_seq) != 1)
+        {
+            perror_exit("Error reading old input file");
+        }
+
+        sector_split(&old_sector[0], &info, 0);
+
+        if (info.mode == SECTOR_MODE_INVALID)
+        {
+            continue;
+        }
+
+        /* Keep the first occurrence of duplicate user data */
+        if (index_find(table, mask, old_rand, &old_pos, &info))
+        {
+            continue;
+        }
+
+        hash = data_hash(info.data, info.size);
+
+        for (slot = hash & mask; table[slot].sector; slot = (slot + 1) & mask)
+        {
+        }
+
+        table[slot].hash   = hash;
+        table[slot].sector = (uint32_t)i + 1;
+    }
+
+    rewind(old_seq);
+
+    if ((!(out = fopen(out_name, "wb"))))
+    {
+        perror_exit("Error opening output file");
+    }
+
+    /* Header, the new image digest is patched in at the end */
+    {
+        uint8_t header[36];
+
+        memcpy(&header[0], PATCH_MAGIC, 8);
+        put_u32(&header[8], (uint32_t)old_count);
+        put_u32(&header[12], (uint32_t)new_count);
+        memset(&header[16], 0, 20);
+        xwrite(&header[0], 36, out);
+    }
+
+    memset(&r, 0, sizeof(r));
+    r.literal = (uint8_t *)xmalloc(PATCH_MAX_LITERAL * 2352);
+
+    memset(&stats[0], 0, sizeof(stats));
+    digest_init(&image);
+
+    for (i = 0; i < new_count; i++)
+    {
+        sector_info info;
+        int         have_old;
+        uint32_t    source;
+
+        if (fread(&new_sector[0], 2352, 1, in) != 1)
+        {
+            perror_exit("Error reading new input file");
+        }
+
+        digest_update(&image, &new_sector[0], 2352);
+
+        have_old = i < old_count &&
+                   fread(&old_sector[0], 2352, 1, old_seq) == 1;
+
+        /* Unchanged sector */
+        if (have_old && memcmp(&old_sector[0], &new_sector[0], 2352) == 0)
+        {
+            record_add(&r, 'S', 0, &new_sector[0], NULL, out);
+            stats[0]++;
+
+            continue;
+        }
+
+        sector_split(&new_sector[0], &info, 1);
+
+        if (info.mode == SECTOR_MODE_INVALID)
+        {
+            record_add(&r, 'R', 0, &new_sector[0], &info, out);
+            stats[3]++;
+
+            continue;
+        }
+
+        /* Continue a copy from the old image, otherwise search for it */
+        source = 0;
+
+        if (r.op == 'C' && r.source + r.count < old_count)
+        {
+            sector_info candidate;
+            uint8_t     sector[2352];
+
+            if (read_sector(old_rand,
+                            &old_pos,
+                            r.source + r.count,
+                            &sector[0]))
+            {
+                sector_split(&sector[0], &candidate, 0);
+
+                if (candidate.mode != SECTOR_MODE_INVALID &&
+                    candidate.size == info.size &&
+                    memcmp(candidate.data, info.data, info.size) == 0)
+                {
+                    source = r.source + r.count + 1;
+                }
+            }
+        }
+
+        if (!source)
+        {
+            source = index_find(table, mask, old_rand, &old_pos, &info);
+        }
+
+        if (source)
+        {
+            record_add(&r, 'C', source - 1, &new_sector[0], &info, out);
+            stats[1]++;
+        }
+        else
+        {
+            record_add(&r, 'D', 0, &new_sector[0], &info, out);
+            stats[2]++;
+        }
+    }
+
+    record_flush(&r, out);
+
+    digest_final(&image, &result);
+
+    if (fseek(out, 16, SEEK_SET) == -1)
+    {
+        perror_exit("Error writing output file");
+    }
+
+    xwrite(&result.sha1[0], 20, out);
+
+    if (fclose(out) != 0)
+    {
+        perror_exit("Error writing output file");
+    }
+
+    printf("Same: %lu, Moved: %lu, Changed: %lu, Raw: %lu\n",
+           stats[0],
+           stats[1],
+           stats[2],
+           stats[3]);
+
+    fclose(old_seq);
+    fclose(old_rand);
+    fclose(in);
+    free(table);
+    free(r.literal);
+}
+
+/*******************************************************************************
+apply
+*******************************************************************************/
+/* Rebuild the new image from the old image and a patch */
+void apply(const char * old_name,
+           const char * patch_name,
+           const char * out_name)
+{
+    FILE *        old;
+    FILE *        patch;
+    FILE *        out;
+    unsigned long old_pos;
+    unsigned long new_count;
+    unsigned long new_num;
+    uint8_t       expected[20];
+    uint8_t       sector[2352];
+    uint8_t       data[2352];
+    digest        image;
+    digest_result result;
+
+    if ((!(old = fopen(old_name, "rb"))))
+    {
+        perror_exit("Error opening old input file");
+    }
+
+    if ((!(patch = fopen(patch_name, "rb"))))
+    {
+        perror_exit("Error opening patch file");
+    }
+
+    {
+        uint8_t header[36];
+
+        xread(&header[0], 36, patch);
+
+        if (memcmp(&header[0], PATCH_MAGIC, 8) != 0)
+        {
+            error_exit("Invalid patch file");
+        }
+
+        if (get_u32(&header[8]) != sector_count(old))
+        {
+            error_exit("Old image does not match patch");
+        }
+
+        new_count = get_u32(&header[12]);
+        memcpy(&expected[0], &header[16], 20);
+    }
+
+    if ((!(out = fopen(out_name, "wb"))))
+    {
+        perror_exit("Error opening output file");
+    }
+
+    old_pos = 0;
+    new_num = 0;
+
+    digest_init(&image);
+
+    while (new_num < new_count)
+    {
+        uint8_t  buf[20];
+        char     op;
+        uint32_t count;
+        uint32_t source;
+        uint8_t  mode;
+        uint8_t  offset[3];
+        uint8_t  sub_header[8];
+        unsigned size;
+
+        xread(&buf[0], 5, patch);
+
+        op     = (char)buf[0];
+        count  = get_u32(&buf[1]);
+        source = 0;
+        mode   = SECTOR_MODE_INVALID;
+        size   = 0;
+
+        if (op == 'C')
+        {
+            xread(&buf[0], 4, patch);
+            source = get_u32(&buf[0]);
+        }
+
+        if (op == 'C' || op == 'D')
+        {
+            xread(&buf[0], 12, patch);
+            mode = buf[0];
+            memcpy(&offset[0], &buf[1], 3);
+            memcpy(&sub_header[0], &buf[4], 8);
+
+            if (!(size = sector_data_size((sector_mode)mode)))
+            {
+                error_exit("Invalid patch file");
+            }
+        }
+        else if (op != 'S' && op != 'R')
+        {
+            error_exit("Invalid patch file");
+        }
+
+        if (count > new_count - new_num)
+        {
+            error_exit("Invalid patch file");
+        }
+
+        while (count--)
+        {
+            if (op == 'S')
+            {
+                if (!read_sector(old, &old_pos, new_num, &sector[0]))
+                {
+                    error_exit("Old image does not match patch");
+                }
+            }
+            else if (op == 'R')
+            {
+                xread(&sector[0], 2352, patch);
+            }
+            else
+            {
+                if (op == 'C')
+                {
+                    sector_info info;
+
+                    if (!read_sector(old, &old_pos, source++, &sector[0]))
+                    {
+                        error_exit("Old image does not match patch");
+                    }
+
+                    sector_split(&sector[0], &info, 0);
+
+                    if (info.mode == SECTOR_MODE_INVALID || info.size != size)
+                    {
+                        error_exit("Old image does not match patch");
+                    }
+
+                    memcpy(&data[0], info.data, size);
+                }
+                else
+                {
+                    xread(&data[0], size, patch);
+                }
+
+                sector_encode(&sector[0],
+                              &offset[0],
+                              (sector_mode)mode,
+                              &sub_header[0],
+                              &data[0]);
+
+                sector_offset_next(&offset[0], &offset[0]);
+            }
+
+            digest_update(&image, &sector[0], 2352);
+            xwrite(&sector[0], 2352, out);
+
+            new_num++;
+        }
+    }
+
+    if (fclose(out) != 0)
+    {
+        perror_exit("Error writing output file");
+    }
+
+    digest_final(&image, &result);
+
+    if (memcmp(&result.sha1[0], &expected[0], 20) != 0)
+    {
+        error_exit("Patched image does not match patch digest");
+    }
+
+    printf("Patched %lu sectors\n", new_num);
+
+    fclose(old);
+    fclose(patch);
+}
+
+/*******************************************************************************
+main()
+*******************************************************************************/
+int main(int argc, const char ** argv)
+{
+    if (argc != 5)
+    {
+        help_exit(argv[0]);
+    }
+
+    if (strcmp(argv[1], "diff") == 0)
+    {
+        diff(argv[2], argv[3], argv[4]);
+    }
+    else if (strcmp(argv[1], "apply") == 0)
+    {
+        apply(argv[2], argv[3], argv[4]);
+    }
+    else
+    {
+        help_exit(argv[0]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,812 @@
+/*******************************************************************************
+ * Deduplicating .bin store using CD-ROM Sector Library
+ * Copyright (C) 2026 Aaron Clovsky
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/*
+    Store layout:
+    - <store>/<sha1>.chunk: Unique run of sector user data
+    - <store>/<name>.manifest: Chunk list and sector runs for one image
+
+    Only user data is stored, sync, header, EDC and ECC are regenerated on
+    restore. Sectors which do not regenerate bit-exactly (audio, corrupt EDC,
+    non-zero Mode 1 padding, etc.) are stored as raw 2352 byte payloads.
+
+    Chunk boundaries are sector aligned and content defined so that data
+    shared between images lands in identical chunks regardless of position.
+*/
+
+/*******************************************************************************
+Headers
+*******************************************************************************/
+#include <sector.h>
+#include <digest.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*******************************************************************************
+Constants
+*******************************************************************************/
+#define CHUNK_MIN_SECTORS 32
+#define CHUNK_MAX_SECTORS 1024
+#define CHUNK_CUT_MASK    0xff /* Average chunk of ~256 sectors */
+
+/*******************************************************************************
+Types
+*******************************************************************************/
+typedef struct
+{
+    char          sha1[41];
+    unsigned long size;
+} chunk_entry;
+
+typedef struct
+{
+    sector_mode   mode; /* SECTOR_MODE_INVALID means raw 2352 byte sectors */
+    unsigned long count;
+    uint8_t       offset[3];
+    uint8_t       sub_header[8];
+} run_entry;
+
+/*******************************************************************************
+Utilities
+*******************************************************************************/
+/* Print error and exit */
+void perror_exit(const char * msg)
+{
+    perror(msg);
+
+    exit(1);
+}
+
+/* Print error and exit */
+void error_exit(const char * msg)
+{
+    fprintf(stderr, "Error: %s\n", msg);
+
+    exit(1);
+}
+
+/* Print help and exit */
+void help_exit(const char * arg)
+{
+    const char * name;
+
+    if ((!(name = strrchr(arg, '/'))))
+    {
+        name = strrchr(arg, '\\');
+    }
+
+    name = name ? &name[1] : arg;
+
+    printf("Usage: %s put <store dir> <name> <input .bin>\n"
+           "       %s get <store dir> <name> <output .bin>\n",
+           name,
+           name);
+
+    exit(2);
+}
+
+/* Allocate or exit */
+void * xmalloc(size_t size)
+{
+    void * p;
+
+    if ((!(p = malloc(size))))
+    {
+        error_exit("Out of memory");
+    }
+
+    return p;
+}
+
+/* Make room for one more element in a growable array */
+void * grow(void * array, size_t * capacity, size_t count, size_t element)
+{
+    if (count < *capacity)
+    {
+        return array;
+    }
+
+    *capacity = *capacity ? *capacity * 2 : 256;
+
+    if ((!(array = realloc(array, *capacity * element))))
+    {
+        error_exit("Out of memory");
+    }
+
+    return array;
+}
+
+/* Build "<store>/<name><suffix>" */
+char * store_path(const char * store, const char * name, const char * suffix)
+{
+    char * path;
+
+    path = (char *)xmalloc(strlen(store) + strlen(name) + strlen(suffix) + 2);
+
+    sprintf(path, "%s/%s%s", store, name, suffix);
+
+    return path;
+}
+
+/* Parse lowercase or uppercase hex into bytes, returns 0 on bad input */
+int hex_decode(const char * str, uint8_t * bytes, unsigned size)
+{
+    unsigned i;
+
+    if (strlen(str) != size * 2)
+    {
+        return 0;
+    }
+
+    for (i = 0; i < size * 2; i++)
+    {
+        unsigned nibble;
+        char     c;
+
+        c = str[i];
+
+        if (c >= '0' && c <= '9') nibble = (unsigned)(c - '0');
+        else if (c >= 'a' && c <= 'f') nibble = (unsigned)(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F') nibble = (unsigned)(c - 'A' + 10);
+        else return 0;
+
+        if (i & 1) bytes[i >> 1] |= (uint8_t)nibble;
+        else bytes[i >> 1] = (uint8_t)(nibble << 4);
+    }
+
+    return 1;
+}
+
+/* Format bytes as lowercase hex
+   Note: str must point to at least size * 2 + 1 bytes */
+void hex_encode(const uint8_t * bytes, unsigned size, char * str)
+{
+    const char HEX[] = "0123456789abcdef";
+    unsigned   i;
+
+    for (i = 0; i < size; i++)
+    {
+        *str++ = HEX[bytes[i] >> 4];
+        *str++ = HEX[bytes[i] & 15];
+    }
+
+    *str = '\0';
+}
+
+/* Content defined chunking hash (FNV-1a) of one sector's user data */
+uint32_t cut_hash(const uint8_t * data, unsigned size)
+{
+    uint32_t h;
+
+    h = 2166136261u;
+
+    while (size--)
+    {
+        h = (h ^ *data++) * 16777619u;
+    }
+
+    return h;
+}
+
+/*******************************************************************************
+put
+*******************************************************************************/
+/* Check that a complete chunk file exists
+   Note: Only the size is checked, get verifies the SHA-1 */
+int chunk_present(const char * path, unsigned long size)
+{
+    FILE * f;
+    long   f_size;
+
+    if ((!(f = fopen(path, "rb"))))
+    {
+        return 0;
+    }
+
+    f_size = (fseek(f, 0, SEEK_END) == 0) ? ftell(f) : -1;
+
+    fclose(f);
+
+    return f_size >= 0 && (unsigned long)f_size == size;
+}
+
+/* Remove a temporary file and exit, preserving errno for the message */
+void chunk_abort(const char * tmp, const char * msg)
+{
+    int saved;
+
+    saved = errno;
+    remove(tmp);
+    errno = saved;
+
+    perror_exit(msg);
+}
+
+/* Hash a chunk and write it to the store unless it is already there
+   Notes:
+   - Returns 1 if the chunk was new
+   - The chunk is written under a temporary name and renamed into place, so
+     an interrupted or failed write never leaves a truncated chunk under its
+     content hash, a chunk of the wrong size is replaced */
+int chunk_put(const char *    store,
+              const uint8_t * chunk,
+              unsigned long   size,
+              chunk_entry *   entry)
+{
+    static unsigned long serial;
+    digest               state;
+    digest_result        result;
+    char *               path;
+    char *               tmp;
+    FILE *               f;
+
+    digest_init(&state);
+    digest_update(&state, chunk, size);
+    digest_final(&state, &result);
+
+    hex_encode(&result.sha1[0], 20, &entry->sha1[0]);
+    entry->size = size;
+
+    path = store_path(store, entry->sha1, ".chunk");
+
+    if (chunk_present(path, size))
+    {
+        free(path);
+
+        return 0;
+    }
+
+    /* Unique per process (stack address) and per call, for concurrent puts */
+    tmp = (char *)xmalloc(strlen(path) + 64);
+
+    sprintf(tmp,
+            "%s.%lx%lx%lx.tmp",
+            path,
+            (unsigned long)time(NULL),
+            (unsigned long)(size_t)&state,
+            serial++);
+
+    if ((!(f = fopen(tmp, "wb"))))
+    {
+        perror_exit("Error creating chunk file");
+    }
+
+    if (fwrite(chunk, size, 1, f) != 1)
+    {
+        fclose(f);
+        chunk_abort(tmp, "Error writing chunk file");
+    }
+
+    if (fclose(f) != 0)
+    {
+        chunk_abort(tmp, "Error writing chunk file");
+    }
+
+    /* Some platforms refuse to rename over an existing file, which may be a
+       bad chunk or one a concurrent put has just completed */
+    if (rename(tmp, path) != 0)
+    {
+        if (chunk_present(path, size))
+        {
+            remove(tmp);
+        }
+        else
+        {
+            remove(path);
+
+            if (rename(tmp, path) != 0)
+            {
+                chunk_abort(tmp, "Error renaming chunk file");
+            }
+        }
+    }
+
+    free(tmp);
+    free(path);
+
+    return 1;
+}
+
+/* Split image into runs of regenerable sectors and deduplicated chunks */
+void put(const char * store, const char * name, const char * in_name)
+{
+    FILE *        in;
+    FILE *        manifest;
+    char *        path;
+    uint8_t *     chunk;
+    unsigned long chunk_size;
+    unsigned      chunk_sectors;
+    chunk_entry * chunks;
+    size_t        chunk_count;
+    size_t        chunk_capacity;
+    unsigned long chunk_added;
+    uint64_t      bytes_added;
+    run_entry *   runs;
+    size_t        run_count;
+    size_t        run_capacity;
+    uint8_t       next_offset[3];
+    int           next_valid;
+    unsigned long sector_num;
+    digest        image;
+    digest_result result;
+    char          str[83];
+    size_t        i;
+
+    if ((!(in = fopen(in_name, "rb"))))
+    {
+        perror_exit("Error opening input file");
+    }
+
+    chunk          = (uint8_t *)xmalloc(CHUNK_MAX_SECTORS * 2352);
+    chunk_size     = 0;
+    chunk_sectors  = 0;
+    chunks         = NULL;
+    chunk_count    = 0;
+    chunk_capacity = 0;
+    chunk_added    = 0;
+    bytes_added    = 0;
+    runs           = NULL;
+    run_count      = 0;
+    run_capacity   = 0;
+    next_valid     = 0;
+    sector_num     = 0;
+
+    digest_init(&image);
+
+    {
+        uint8_t               sector[2352];
+        uint8_t               rebuilt[2352];
+        const sector_header * header;
+        const void *          data;
+        sector_mode           mode;
+        sector_error          error;
+        const uint8_t *       payload;
+        unsigned              size;
+        static const uint8_t  NO_SUB_HEADER[8] = { 0 };
+        const uint8_t *       sub_header;
+        run_entry *           run;
+        size_t                read;
+
+        header = (const sector_header *)&sector[0];
+
+        while ((read = fread(&sector[0], 1, 2352, in)) == 2352)
+        {
+            digest_update(&image, &sector[0], 2352);
+
+            error = sector_analyze(&sector[0], &data, &mode);
+
+            if (error == SECTOR_ERROR_INVALID_SYNC ||
+                error == SECTOR_ERROR_INVALID_MODE)
+            {
+                mode = SECTOR_MODE_INVALID;
+            }
+
+            sub_header = (mode == SECTOR_MODE_2_FORM_1 ||
+                          mode == SECTOR_MODE_2_FORM_2) ?
+                             &sector[16] :
+                             &NO_SUB_HEADER[0];
+
+            /* Only keep user data if the rest regenerates bit-exactly */
+            if (mode != SECTOR_MODE_INVALID)
+            {
+                sector_encode(&rebuilt[0],
+                              &header->offset[0],
+                              mode,
+                              sub_header,
+                              data);
+
+                if (memcmp(&rebuilt[0], &sector[0], 2352) != 0)
+                {
+                    mode       = SECTOR_MODE_INVALID;
+                    sub_header = &NO_SUB_HEADER[0];
+                }
+            }
+
+            if (mode == SECTOR_MODE_INVALID)
+            {
+                payload = &sector[0];
+                size    = 2352;
+            }
+            else
+            {
+                payload = (const uint8_t *)data;
+                size    = sector_data_size(mode);
+            }
+
+            /* Extend the current run or start a new one */
+            run = run_count ? &runs[run_count - 1] : NULL;
+
+            if (run && run->mode == mode &&
+                (mode == SECTOR_MODE_INVALID ||
+                 (next_valid &&
+                  memcmp(&next_offset[0], &header->offset[0], 3) == 0 &&
+                  memcmp(&run->sub_header[0], sub_header, 8) == 0)))
+            {
+                run->count++;
+            }
+            else
+            {
+                runs = (run_entry *)
+                    grow(runs, &run_capacity, run_count, sizeof(run_entry));
+                run = &runs[run_count++];
+
+                run->mode  = mode;
+                run->count = 1;
+                memcpy(&run->offset[0], &header->offset[0], 3);
+                memcpy(&run->sub_header[0], sub_header, 8);
+            }
+
+            next_valid =
+                sector_offset_next(&header->offset[0], &next_offset[0]);
+
+            /* Append to the current chunk, cutting on content */
+            memcpy(&chunk[chunk_size], payload, size);
+            chunk_size += size;
+            chunk_sectors++;
+
+            if (chunk_sectors == CHUNK_MAX_SECTORS ||
+                (chunk_sectors >= CHUNK_MIN_SECTORS &&
+                 (cut_hash(payload, size) & CHUNK_CUT_MASK) == 0))
+            {
+                chunks = (chunk_entry *)grow(
+                    chunks, &chunk_capacity, chunk_count, sizeof(chunk_entry));
+
+                if (chunk_put(store, chunk, chunk_size, &chunks[chunk_count]))
+                {
+                    chunk_added++;
+                    bytes_added += chunk_size;
+                }
+
+                chunk_count++;
+                chunk_size    = 0;
+                chunk_sectors = 0;
+            }
+
+            sector_num++;
+        }
+
+        if (ferror(in))
+        {
+            perror_exit("Error reading input file");
+        }
+
+        if (read != 0)
+        {
+            error_exit("Input file size not divisible by 2352");
+        }
+
+        if (chunk_sectors)
+        {
+            chunks = (chunk_entry *)grow(
+                chunks, &chunk_capacity, chunk_count, sizeof(chunk_entry));
+
+            if (chunk_put(store, chunk, chunk_size, &chunks[chunk_count]))
+            {
+                chunk_added++;
+                bytes_added += chunk_size;
+            }
+
+            chunk_count++;
+        }
+    }
+
+    fclose(in);
+
+    digest_final(&image, &result);
+    digest_string(&result, &str[0]);
+
+    /* Write manifest */
+    path = store_path(store, name, ".manifest");
+
+    if ((!(manifest = fopen(path, "w"))))
+    {
+        perror_exit("Error creating manifest file");
+    }
+
+    fprintf(manifest, "binstore 1\nimage %lu %s\n", sector_num, str);
+    fprintf(manifest, "chunks %lu\n", (unsigned long)chunk_count);
+
+    for (i = 0; i < chunk_count; i++)
+    {
+        fprintf(manifest, "%s %lu\n", chunks[i].sha1, chunks[i].size);
+    }
+
+    fprintf(manifest, "runs %lu\n", (unsigned long)run_count);
+
+    for (i = 0; i < run_count; i++)
+    {
+        char offset[7];
+        char sub_header[17];
+
+        hex_encode(&runs[i].offset[0], 3, &offset[0]);
+        hex_encode(&runs[i].sub_header[0], 8, &sub_header[0]);
+
+        fprintf(manifest,
+                "%d %lu %s %s\n",
+                (int)runs[i].mode,
+                runs[i].count,
+                offset,
+                sub_header);
+    }
+
+    if (ferror(manifest) || fclose(manifest) != 0)
+    {
+        perror_exit("Error writing manifest file");
+    }
+
+    printf("Stored %lu sectors: %lu chunks, %lu new (%lu KiB), %lu runs\n",
+           sector_num,
+           (unsigned long)chunk_count,
+           chunk_added,
+           (unsigned long)((bytes_added + 1023) / 1024),
+           (unsigned long)run_count);
+
+    free(path);
+    free(chunk);
+    free(chunks);
+    free(runs);
+}
+
+/*******************************************************************************
+get
+*******************************************************************************/
+/* Load and verify a chunk, returns its size */
+unsigned long chunk_get(const char *        store,
+                        const chunk_entry * entry,
+                        uint8_t *           chunk)
+{
+    digest        state;
+    digest_result result;
+    char          sha1[41];
+    char *        path;
+    FILE *        f;
+
+    if (entry->size > CHUNK_MAX_SECTORS * 2352)
+    {
+        error_exit("Corrupt manifest: chunk too large");
+    }
+
+    path = store_path(store, entry->sha1, ".chunk");
+
+    if ((!(f = fopen(path, "rb"))))
+    {
+        perror_exit("Error opening chunk file");
+    }
+
+    if (fread(chunk, 1, entry->size, f) != entry->size)
+    {
+        error_exit("Chunk file truncated");
+    }
+
+    fclose(f);
+    free(path);
+
+    digest_init(&state);
+    digest_update(&state, chunk, entry->size);
+    digest_final(&state, &result);
+    hex_encode(&result.sha1[0], 20, &sha1[0]);
+
+    if (strcmp(sha1, entry->sha1) != 0)
+    {
+        error_exit("Chunk file corrupt");
+    }
+
+    return entry->size;
+}
+
+/* Rebuild image from manifest, regenerating headers, EDC and ECC */
+void get(const char * store, const char * name, const char * out_name)
+{
+    FILE *        manifest;
+    FILE *        out;
+    char *        path;
+    uint8_t *     chunk;
+    unsigned long chunk_size;
+    unsigned long chunk_pos;
+    chunk_entry * chunks;
+    unsigned long chunk_count;
+    unsigned long chunk_index;
+    unsigned long run_count;
+    unsigned long sector_count;
+    unsigned long sector_num;
+    char          expected[83];
+    char          str[83];
+    digest        image;
+    digest_result result;
+    unsigned long i;
+
+    path = store_path(store, name, ".manifest");
+
+    if ((!(manifest = fopen(path, "r"))))
+    {
+        perror_exit("Error opening manifest file");
+    }
+
+    free(path);
+
+    /* Read header and chunk list */
+    {
+        char crc32[9];
+        char md5[33];
+        char sha1[41];
+
+        if (fscanf(manifest,
+                   "binstore 1 image %lu %8s %32s %40s chunks %lu",
+                   &sector_count,
+                   crc32,
+                   md5,
+                   sha1,
+                   &chunk_count) != 5)
+        {
+            error_exit("Invalid manifest");
+        }
+
+        sprintf(expected, "%s %s %s", crc32, md5, sha1);
+    }
+
+    chunks = (chunk_entry *)xmalloc((chunk_count + 1) * sizeof(chunk_entry));
+
+    for (i = 0; i < chunk_count; i++)
+    {
+        if (fscanf(manifest, "%40s %lu", chunks[i].sha1, &chunks[i].size) != 2)
+        {
+            error_exit("Invalid manifest");
+        }
+    }
+
+    if (fscanf(manifest, " runs %lu", &run_count) != 1)
+    {
+        error_exit("Invalid manifest");
+    }
+
+    if ((!(out = fopen(out_name, "wb"))))
+    {
+        perror_exit("Error opening output file");
+    }
+
+    chunk       = (uint8_t *)xmalloc(CHUNK_MAX_SECTORS * 2352);
+    chunk_size  = 0;
+    chunk_pos   = 0;
+    chunk_index = 0;
+    sector_num  = 0;
+
+    digest_init(&image);
+
+    /* Stream runs, pulling user data from chunks in order */
+    for (i = 0; i < run_count; i++)
+    {
+        int           mode;
+        unsigned long count;
+        char          offset_str[7];
+        char          sub_header_str[17];
+        uint8_t       offset[3];
+        uint8_t       sub_header[8];
+        uint8_t       sector[2352];
+        unsigned      size;
+
+        if (fscanf(manifest,
+                   "%d %lu %6s %16s",
+                   &mode,
+                   &count,
+                   offset_str,
+                   sub_header_str) != 4 ||
+            !hex_decode(offset_str, &offset[0], 3) ||
+            !hex_decode(sub_header_str, &sub_header[0], 8) ||
+            mode < SECTOR_MODE_INVALID || mode > SECTOR_MODE_2_FORM_2)
+        {
+            error_exit("Invalid manifest");
+        }
+
+        size = (mode == SECTOR_MODE_INVALID) ?
+                   2352 :
+                   sector_data_size((sector_mode)mode);
+
+        while (count--)
+        {
+            if (chunk_pos == chunk_size)
+            {
+                if (chunk_index == chunk_count)
+                {
+                    error_exit("Corrupt manifest: out of chunks");
+                }
+
+                chunk_size = chunk_get(store, &chunks[chunk_index++], chunk);
+                chunk_pos  = 0;
+            }
+
+            if (chunk_pos + size > chunk_size)
+            {
+                error_exit("Corrupt manifest: sector spans chunks");
+            }
+
+            if (mode == SECTOR_MODE_INVALID)
+            {
+                memcpy(&sector[0], &chunk[chunk_pos], 2352);
+            }
+            else
+            {
+                sector_encode(&sector[0],
+                              &offset[0],
+                              (sector_mode)mode,
+                              &sub_header[0],
+                              &chunk[chunk_pos]);
+
+                sector_offset_next(&offset[0], &offset[0]);
+            }
+
+            chunk_pos += size;
+
+            digest_update(&image, &sector[0], 2352);
+
+            if (fwrite(&sector[0], 2352, 1, out) != 1)
+            {
+                perror_exit("Error writing output file");
+            }
+
+            sector_num++;
+        }
+    }
+
+    fclose(manifest);
+
+    if (fclose(out) != 0)
+    {
+        perror_exit("Error writing output file");
+    }
+
+    digest_final(&image, &result);
+    digest_string(&result, &str[0]);
+
+    if (sector_num != sector_count || strcmp(str, expected) != 0)
+    {
+        error_exit("Restored image does not match manifest digest");
+    }
+
+    printf("Restored %lu sectors\n", sector_num);
+
+    free(chunk);
+    free(chunks);
+}
+
+/*******************************************************************************
+main()
+*******************************************************************************/
+int main(int argc, const char ** argv)
+{
+    if (argc != 5)
+    {
+        help_exit(argv[0]);
+    }
+
+    if (strcmp(argv[1], "put") == 0)
+    {
+        put(argv[2], argv[3], argv[4]);
+    }
+    else if (strcmp(argv[1], "get") == 0)
+    {
+        get(argv[2], argv[3], argv[4]);
+    }
+    else
+    {
+        help_exit(argv[0]);
+    }
+
+    return 0;
+}
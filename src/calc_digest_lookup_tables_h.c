@@ -0,0 +1,96 @@
+/*******************************************************************************
+ * Digest Library lookup tables generator
+ * Copyright (C) 2026 Aaron Clovsky
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/*******************************************************************************
+Headers
+*******************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+
+/*******************************************************************************
+Globals
+*******************************************************************************/
+uint32_t DIGEST_CRC32_TABLE[256];
+
+/*******************************************************************************
+CRC32 Table calculation
+*******************************************************************************/
+/* Compute reflected CRC32 (IEEE 802.3) lookup table */
+void calc_crc32_table()
+{
+    unsigned i;
+
+    for (i = 0; i < 256; i++)
+    {
+        uint32_t data;
+        unsigned k;
+
+        data = i;
+
+        for (k = 0; k < 8; k++)
+        {
+            data = (data & 1) ? (data >> 1) ^ 0xEDB88320 : data >> 1;
+        }
+
+        DIGEST_CRC32_TABLE[i] = data;
+    }
+}
+
+/*******************************************************************************
+Produce header file
+*******************************************************************************/
+int main()
+{
+    unsigned i;
+
+    calc_crc32_table();
+
+    puts("/***************************************"
+         "****************************************\n"
+         " * Digest Library CRC32 Lookup Table\n"
+         " * Copyright (C) 2026 Aaron Clovsky\n"
+         " ***************************************"
+         "***************************************/\n"
+         "#ifndef DIGEST_LOOKUP_TABLES_HEADER\n"
+         "#define DIGEST_LOOKUP_TABLES_HEADER\n");
+    puts("/***************************************"
+         "****************************************\n"
+         "Headers\n"
+         "****************************************"
+         "***************************************/\n"
+         "#include <stdint.h>\n\n"
+         "/***************************************"
+         "****************************************\n"
+         "Constants\n"
+         "****************************************"
+         "***************************************/\n"
+         "static const uint32_t DIGEST_CRC32_TABLE[256] = {");
+
+    for (i = 0; i < 64; i++)
+    {
+        printf("    0x%08X, 0x%08X, 0x%08X, 0x%08X%s\n",
+               DIGEST_CRC32_TABLE[i * 4 + 0],
+               DIGEST_CRC32_TABLE[i * 4 + 1],
+               DIGEST_CRC32_TABLE[i * 4 + 2],
+               DIGEST_CRC32_TABLE[i * 4 + 3],
+               (i != 63) ? "," : "");
+    }
+
+    puts("};\n\n#endif");
+
+    return 0;
+}
@@ -27,6 +27,7 @@ Globals
 *******************************************************************************/
 uint32_t SECTOR_CRC_TABLE[256];
 uint16_t SECTOR_COEFF_TABLE[43][256];
+uint8_t  SECTOR_BCD_TABLE[256];
 
 /*******************************************************************************
 CRC Table calculation
@@ -156,6 +157,27 @@ void calc_coeff_table()
     }
 }
 
+/*******************************************************************************
+BCD Table calculation
+*******************************************************************************/
+/* Compute BCD to binary lookup table, 0xFF marks invalid BCD */
+void calc_bcd_table()
+{
+    unsigned i;
+
+    for (i = 0; i < 256; i++)
+    {
+        if ((i >> 4) > 9 || (i & 15) > 9)
+        {
+            SECTOR_BCD_TABLE[i] = 0xff;
+        }
+        else
+        {
+            SECTOR_BCD_TABLE[i] = (uint8_t)((i >> 4) * 10 + (i & 15));
+        }
+    }
+}
+
 /*******************************************************************************
 Produce header file
 *******************************************************************************/
@@ -166,10 +188,11 @@ int main()
 
     calc_crc_table();
     calc_coeff_table();
+    calc_bcd_table();
 
     puts("/***************************************"
          "****************************************\n"
-         " * CD-ROM Sector Library EDC/ECC Lookup Tables\n"
+         " * CD-ROM Sector Library EDC/ECC/BCD Lookup Tables\n"
          " * Copyright (C) 2026 Aaron Clovsky\n"
          " * Based on CRDDAO\n"
          " ***************************************"
@@ -223,6 +246,20 @@ int main()
         puts((i != 42) ? "    }," : "    }");
     }
 
+    puts("};\n\nstatic const uint8_t SECTOR_BCD_TABLE[256] = {");
+
+    for (i = 0; i < 32; i++)
+    {
+        printf("    ");
+
+        for (k = 0; k < 8; k++)
+        {
+            printf("0x%02X%s",
+                   SECTOR_BCD_TABLE[i * 8 + k],
+                   (k != 7) ? ", " : (i != 31) ? ",\n" : "\n");
+        }
+    }
+
     puts("};\n\n#endif");
 
     return 0;
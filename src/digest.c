@@ -0,0 +1,358 @@
+/*******************************************************************************
+ * Digest Library
+ * Copyright (C) 2026 Aaron Clovsky
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/*******************************************************************************
+Headers
+*******************************************************************************/
+#include <digest.h>
+#include <digest_lookup_tables.h>
+#include <string.h>
+
+/*******************************************************************************
+Macros
+*******************************************************************************/
+#define DIGEST_ROTL(__x__, __n__)                                   \
+    ((uint32_t)(((__x__) << (__n__)) | ((__x__) >> (32 - (__n__)))))
+
+/*******************************************************************************
+Constants
+*******************************************************************************/
+/* MD5 per-round additive constants (RFC 1321) */
+static const uint32_t MD5_T[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a,
+    0xa8304613, 0xfd469501, 0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+    0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821, 0xf61e2562, 0xc040b340,
+    0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8,
+    0x676f02d9, 0x8d2a4c8a, 0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+    0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70, 0x289b7ec6, 0xeaa127fa,
+    0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92,
+    0xffeff47d, 0x85845dd1, 0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+    0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+/* MD5 per-round shift amounts (RFC 1321) */
+static const unsigned MD5_S[4][4] = {
+    { 7, 12, 17, 22 },
+    { 5, 9,  14, 20 },
+    { 4, 11, 16, 23 },
+    { 6, 10, 15, 21 }
+};
+
+/*******************************************************************************
+Internal functions
+*******************************************************************************/
+/* Process one 64 byte block with MD5 */
+static void md5_block(uint32_t * md5, const uint8_t * block)
+{
+    uint32_t x[16];
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+    uint32_t d;
+    unsigned i;
+
+    for (i = 0; i < 16; i++)
+    {
+        x[i] = (uint32_t)block[i * 4 + 0] | (uint32_t)block[i * 4 + 1] << 8 |
+               (uint32_t)block[i * 4 + 2] << 16 |
+               (uint32_t)block[i * 4 + 3] << 24;
+    }
+
+    a = md5[0];
+    b = md5[1];
+    c = md5[2];
+    d = md5[3];
+
+    for (i = 0; i < 64; i++)
+    {
+        uint32_t f;
+        uint32_t t;
+        unsigned g;
+
+        if (i < 16)
+        {
+            f = (b & c) | (~b & d);
+            g = i;
+        }
+        else if (i < 32)
+        {
+            f = (d & b) | (~d & c);
+            g = (5 * i + 1) & 15;
+        }
+        else if (i < 48)
+        {
+            f = b ^ c ^ d;
+            g = (3 * i + 5) & 15;
+        }
+        else
+        {
+            f = c ^ (b | ~d);
+            g = (7 * i) & 15;
+        }
+
+        t = a + f + MD5_T[i] + x[g];
+        a = d;
+        d = c;
+        c = b;
+        b = b + DIGEST_ROTL(t, MD5_S[i >> 4][i & 3]);
+    }
+
+    md5[0] += a;
+    md5[1] += b;
+    md5[2] += c;
+    md5[3] += d;
+}
+
+/* Process one 64 byte block with SHA-1 */
+static void sha1_block(uint32_t * sha1, const uint8_t * block)
+{
+    uint32_t w[80];
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+    uint32_t d;
+    uint32_t e;
+    unsigned i;
+
+    for (i = 0; i < 16; i++)
+    {
+        w[i] = (uint32_t)block[i * 4 + 0] << 24 |
+               (uint32_t)block[i * 4 + 1] << 16 |
+               (uint32_t)block[i * 4 + 2] << 8 | (uint32_t)block[i * 4 + 3];
+    }
+
+    for (i = 16; i < 80; i++)
+    {
+        w[i] = DIGEST_ROTL(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    a = sha1[0];
+    b = sha1[1];
+    c = sha1[2];
+    d = sha1[3];
+    e = sha1[4];
+
+    for (i = 0; i < 80; i++)
+    {
+        uint32_t f;
+        uint32_t t;
+
+        if (i < 20)
+        {
+            f = ((b & c) | (~b & d)) + 0x5a827999;
+        }
+        else if (i < 40)
+        {
+            f = (b ^ c ^ d) + 0x6ed9eba1;
+        }
+        else if (i < 60)
+        {
+            f = ((b & c) | (b & d) | (c & d)) + 0x8f1bbcdc;
+        }
+        else
+        {
+            f = (b ^ c ^ d) + 0xca62c1d6;
+        }
+
+        t = DIGEST_ROTL(a, 5) + f + e + w[i];
+        e = d;
+        d = c;
+        c = DIGEST_ROTL(b, 30);
+        b = a;
+        a = t;
+    }
+
+    sha1[0] += a;
+    sha1[1] += b;
+    sha1[2] += c;
+    sha1[3] += d;
+    sha1[4] += e;
+}
+
+/* Process one 64 byte block with both MD5 and SHA-1 */
+static void digest_block(digest * state, const uint8_t * block)
+{
+    md5_block(&state->md5[0], block);
+    sha1_block(&state->sha1[0], block);
+}
+
+/*******************************************************************************
+External functions
+*******************************************************************************/
+/*
+    Initialize digest state
+*/
+void digest_init(digest * state)
+{
+    state->crc32   = 0xffffffff;
+    state->md5[0]  = 0x67452301;
+    state->md5[1]  = 0xefcdab89;
+    state->md5[2]  = 0x98badcfe;
+    state->md5[3]  = 0x10325476;
+    state->sha1[0] = 0x67452301;
+    state->sha1[1] = 0xefcdab89;
+    state->sha1[2] = 0x98badcfe;
+    state->sha1[3] = 0x10325476;
+    state->sha1[4] = 0xc3d2e1f0;
+    state->length  = 0;
+}
+
+/*
+    Feed data into all digests
+*/
+void digest_update(digest * state, const void * data, size_t size)
+{
+    const uint8_t * p;
+    uint32_t        crc;
+    size_t          i;
+    unsigned        used;
+
+    p   = (const uint8_t *)data;
+    crc = state->crc32;
+
+    /* CRC32 runs inline rather than in parallel chunks joined with a GF(2)
+       shift-combine: MD5 and SHA-1 cannot be split and take about three
+       quarters of the time here, so the whole update stays bound by them
+       and threading the CRC would save at most the remaining quarter */
+    for (i = 0; i < size; i++)
+    {
+        crc = DIGEST_CRC32_TABLE[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+    }
+
+    state->crc32 = crc;
+
+    used           = (unsigned)(state->length & 63);
+    state->length += size;
+
+    /* Complete a partially filled block first */
+    if (used)
+    {
+        unsigned fill;
+
+        fill = 64 - used;
+
+        if (size < fill)
+        {
+            memcpy(&state->block[used], p, size);
+
+            return;
+        }
+
+        memcpy(&state->block[used], p, fill);
+        digest_block(state, &state->block[0]);
+
+        p    += fill;
+        size -= fill;
+    }
+
+    /* Hash whole blocks in place */
+    while (size >= 64)
+    {
+        digest_block(state, p);
+
+        p    += 64;
+        size -= 64;
+    }
+
+    memcpy(&state->block[0], p, size);
+}
+
+/*
+    Finalize digests
+*/
+void digest_final(digest * state, digest_result * result)
+{
+    uint64_t bits;
+    unsigned used;
+    unsigned i;
+
+    bits = state->length << 3;
+    used = (unsigned)(state->length & 63);
+
+    /* Pad, leaving room for the 64 bit length */
+    state->block[used++] = 0x80;
+
+    if (used > 56)
+    {
+        memset(&state->block[used], 0, 64 - used);
+        digest_block(state, &state->block[0]);
+        used = 0;
+    }
+
+    memset(&state->block[used], 0, 56 - used);
+
+    /* MD5 takes the length little-endian, SHA-1 takes it big-endian */
+    for (i = 0; i < 8; i++)
+    {
+        state->block[56 + i] = (uint8_t)(bits >> (i * 8));
+    }
+
+    md5_block(&state->md5[0], &state->block[0]);
+
+    for (i = 0; i < 8; i++)
+    {
+        state->block[63 - i] = (uint8_t)(bits >> (i * 8));
+    }
+
+    sha1_block(&state->sha1[0], &state->block[0]);
+
+    result->crc32 = state->crc32 ^ 0xffffffff;
+
+    for (i = 0; i < 16; i++)
+    {
+        result->md5[i] = (uint8_t)(state->md5[i >> 2] >> ((i & 3) * 8));
+    }
+
+    for (i = 0; i < 20; i++)
+    {
+        result->sha1[i] = (uint8_t)(state->sha1[i >> 2] >> ((3 - (i & 3)) * 8));
+    }
+}
+
+/*
+    Format result as "<crc32> <md5> <sha1>" in lowercase hex
+*/
+void digest_string(const digest_result * result, char * str)
+{
+    const char HEX[] = "0123456789abcdef";
+    unsigned   i;
+
+    for (i = 0; i < 8; i++)
+    {
+        *str++ = HEX[(result->crc32 >> ((7 - i) * 4)) & 15];
+    }
+
+    *str++ = ' ';
+
+    for (i = 0; i < 16; i++)
+    {
+        *str++ = HEX[result->md5[i] >> 4];
+        *str++ = HEX[result->md5[i] & 15];
+    }
+
+    *str++ = ' ';
+
+    for (i = 0; i < 20; i++)
+    {
+        *str++ = HEX[result->sha1[i] >> 4];
+        *str++ = HEX[result->sha1[i] & 15];
+    }
+
+    *str = '\0';
+}
@@ -0,0 +1,79 @@
+/*******************************************************************************
+ * Large File Helpers
+ * Copyright (C) 2026 Aaron Clovsky
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/*******************************************************************************
+Macros
+*******************************************************************************/
+/* fseeko()/ftello() are POSIX, not C89, and need a 64 bit off_t on 32 bit
+   systems, the Makefile also passes _FILE_OFFSET_BITS to every tool so that
+   fopen() accepts files over 2 GiB */
+#ifndef _WIN32
+    #ifndef _FILE_OFFSET_BITS
+        #define _FILE_OFFSET_BITS 64
+    #endif
+    #define _POSIX_C_SOURCE 200112L
+#endif
+
+/*******************************************************************************
+Headers
+*******************************************************************************/
+#include <fileio.h>
+#include <stdio.h>
+#ifndef _WIN32
+    #include <sys/types.h>
+#endif
+
+/*******************************************************************************
+External functions
+*******************************************************************************/
+/*
+    Seek to an absolute 64 bit offset
+*/
+int fileio_seek(FILE * f, uint64_t offset)
+{
+#ifdef _WIN32
+    return _fseeki64(f, (__int64)offset, SEEK_SET) != 0;
+#else
+    return fseeko(f, (off_t)offset, SEEK_SET) != 0;
+#endif
+}
+
+/*
+    Determine the size of a file, leaving the position at the start
+*/
+int fileio_size(FILE * f, uint64_t * size)
+{
+#ifdef _WIN32
+    __int64 end;
+
+    if (_fseeki64(f, 0, SEEK_END) || (end = _ftelli64(f)) < 0)
+    {
+        return 1;
+    }
+#else
+    off_t end;
+
+    if (fseeko(f, 0, SEEK_END) || (end = ftello(f)) < 0)
+    {
+        return 1;
+    }
+#endif
+
+    *size = (uint64_t)end;
+
+    return fileio_seek(f, 0);
+}
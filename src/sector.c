@@ -23,6 +23,15 @@ Headers
 #include <sector_lookup_tables.h>
 #include <string.h>
 
+/*******************************************************************************
+Constants
+*******************************************************************************/
+static const uint8_t SYNC_DATA[] = { 0x00, 0xff, 0xff, 0xff, 0xff, 0xff,
+                                     0xff, 0xff, 0xff, 0xff, 0xff, 0x00 };
+
+/* Number of distinct header addresses (100 minutes) */
+#define ADDRESS_COUNT ((uint32_t)100 * 60 * 75)
+
 /*******************************************************************************
 Internal functions
 *******************************************************************************/
@@ -92,6 +101,106 @@ static void calc_q_parity(const uint8_t * sector, uint8_t * q_parity)
     }
 }
 
+/* Analyze one sector and hand it to the stream callback */
+static sector_error stream_sector(sector_stream * stream,
+                                  const uint8_t * sector)
+{
+    sector_error error;
+    const void * data;
+    sector_mode  mode;
+
+    data  = NULL;
+    mode  = SECTOR_MODE_INVALID;
+    error = sector_analyze(sector, &data, &mode);
+
+    if (stream->callback(stream->user,
+                         stream->sector_num++,
+                         sector,
+                         error,
+                         mode,
+                         data))
+    {
+        return SECTOR_ERROR_ABORTED;
+    }
+
+    return SECTOR_ERROR_NONE;
+}
+
+/* Check one sector header address, see sector_address_check_sector() */
+static sector_address_status check_address(sector_address_check * check,
+                                           const uint8_t *        sector,
+                                           uint32_t               sector_num)
+{
+    uint32_t address;
+    uint32_t expected;
+    uint32_t distance;
+
+    if (memcmp(sector, SYNC_DATA, sizeof(SYNC_DATA)))
+    {
+        return SECTOR_ADDRESS_NONE;
+    }
+
+    if (!sector_offset_decode(&sector[12], &address))
+    {
+        return SECTOR_ADDRESS_INVALID;
+    }
+
+    if (!check->started)
+    {
+        check->started      = 1;
+        check->base_address = address;
+        check->base_sector  = sector_num;
+    }
+    else
+    {
+        expected = (check->base_address +
+                    (sector_num - check->base_sector) % ADDRESS_COUNT) %
+                   ADDRESS_COUNT;
+
+        if (address != expected)
+        {
+            /* Continuing from the previous sector, accept the new sequence */
+            if (address == (check->previous +
+                            (sector_num - check->previous_sector) %
+                                ADDRESS_COUNT) %
+                               ADDRESS_COUNT)
+            {
+                check->base_address = address;
+                check->base_sector  = sector_num;
+            }
+            else
+            {
+                sector_address_status status;
+
+                distance = (address + ADDRESS_COUNT - expected) % ADDRESS_COUNT;
+
+                if (address == check->previous)
+                {
+                    status = SECTOR_ADDRESS_DUPLICATE;
+                }
+                else if (distance < ADDRESS_COUNT / 2)
+                {
+                    status = SECTOR_ADDRESS_GAP;
+                }
+                else
+                {
+                    status = SECTOR_ADDRESS_OUT_OF_ORDER;
+                }
+
+                check->previous        = address;
+                check->previous_sector = sector_num;
+
+                return status;
+            }
+        }
+    }
+
+    check->previous        = address;
+    check->previous_sector = sector_num;
+
+    return SECTOR_ADDRESS_OK;
+}
+
 /*******************************************************************************
 External functions
 *******************************************************************************/
@@ -102,8 +211,6 @@ sector_error sector_analyze(const void *  sector,
                             const void ** data,
                             sector_mode * mode)
 {
-    const uint8_t         SYNC_DATA[] = { 0x00, 0xff, 0xff, 0xff, 0xff, 0xff,
-                                          0xff, 0xff, 0xff, 0xff, 0xff, 0x00 };
     const sector_header * header;
     unsigned              mode_bits;
 
@@ -157,7 +264,7 @@ sector_error sector_analyze(const void *  sector,
             return SECTOR_ERROR_NONE;
         }
 
-        form_bit = form_1->sub_header[2] & 0x20;
+        form_bit = form_1->sub_header[2] & SECTOR_SUBMODE_FORM_2;
 
         /* Check EDC to confirm subheader data */
         if (!form_bit)
@@ -244,8 +351,8 @@ void sector_calc_ecc(const void * sector, sector_mode mode, uint8_t * ecc)
         memcpy(&copy[0], sector, 2352);
         *(uint32_t *)&copy[2068] = 0;
         *(uint32_t *)&copy[2072] = 0;
-        calc_p_parity(&copy[0], &ecc[0]);
-        calc_q_parity(&copy[0], &ecc[172]);
+        calc_p_parity(&copy[0], &copy[2076]);
+        calc_q_parity(&copy[0], &copy[2248]);
         memcpy(ecc, &copy[2076], 276);
     }
     else if (mode == SECTOR_MODE_2_FORM_1)
@@ -258,6 +365,290 @@ void sector_calc_ecc(const void * sector, sector_mode mode, uint8_t * ecc)
     }
 }
 
+/*
+    Build a complete sector from address, mode, subheader and data
+*/
+sector_error sector_encode(void *          sector,
+                           const uint8_t * offset,
+                           sector_mode     mode,
+                           const uint8_t * sub_header,
+                           const void *    data)
+{
+    sector_header * header;
+    uint8_t *       raw;
+
+    header = (sector_header *)sector;
+    raw    = (uint8_t *)sector;
+
+    memcpy(&header->sync[0], &SYNC_DATA[0], sizeof(SYNC_DATA));
+    memcpy(&header->offset[0], offset, 3);
+
+    if (mode == SECTOR_MODE_0)
+    {
+        header->mode_bits = 0;
+        memcpy(&raw[16], data, 2336);
+    }
+    else if (mode == SECTOR_MODE_1)
+    {
+        sector_mode_1 * mode_1;
+
+        mode_1 = (sector_mode_1 *)sector;
+
+        header->mode_bits = 1;
+        memcpy(&mode_1->data[0], data, 2048);
+        mode_1->edc = sector_calc_edc(sector, mode);
+        memset(&mode_1->zero[0], 0, 8);
+        sector_calc_ecc(sector, mode, &mode_1->ecc[0]);
+    }
+    else if (mode == SECTOR_MODE_2)
+    {
+        header->mode_bits = 2;
+        memcpy(&raw[16], data, 2336);
+    }
+    else if (mode == SECTOR_MODE_2_FORM_1)
+    {
+        sector_mode_2_form_1 * form_1;
+
+        form_1 = (sector_mode_2_form_1 *)sector;
+
+        header->mode_bits = 2;
+        memcpy(&form_1->sub_header[0], sub_header, 8);
+        memcpy(&form_1->data[0], data, 2048);
+        form_1->edc = sector_calc_edc(sector, mode);
+        sector_calc_ecc(sector, mode, &form_1->ecc[0]);
+    }
+    else if (mode == SECTOR_MODE_2_FORM_2)
+    {
+        sector_mode_2_form_2 * form_2;
+
+        form_2 = (sector_mode_2_form_2 *)sector;
+
+        header->mode_bits = 2;
+        memcpy(&form_2->sub_header[0], sub_header, 8);
+        memcpy(&form_2->data[0], data, 2324);
+        form_2->edc = sector_calc_edc(sector, mode);
+    }
+    else
+    {
+        return SECTOR_ERROR_INVALID_MODE;
+    }
+
+    return SECTOR_ERROR_NONE;
+}
+
+/*
+    Advance a BCD header address by one sector
+*/
+int sector_offset_next(const uint8_t * offset, uint8_t * next)
+{
+    uint32_t address;
+
+    if (!sector_offset_decode(offset, &address))
+    {
+        return 0;
+    }
+
+    sector_offset_encode(address + 1, next);
+
+    return 1;
+}
+
+/*
+    Decode a BCD header address to an absolute frame number
+*/
+int sector_offset_decode(const uint8_t * offset, uint32_t * address)
+{
+    unsigned minute;
+    unsigned second;
+    unsigned frame;
+
+    minute = SECTOR_BCD_TABLE[offset[0]];
+    second = SECTOR_BCD_TABLE[offset[1]];
+    frame  = SECTOR_BCD_TABLE[offset[2]];
+
+    /* Invalid BCD decodes to 0xFF, valid values never have the top bit set */
+    if (((minute | second | frame) & 0x80) || second > 59 || frame > 74)
+    {
+        return 0;
+    }
+
+    *address = (uint32_t)minute * 4500 + second * 75 + frame;
+
+    return 1;
+}
+
+/*
+    Encode an absolute frame number as a BCD header address
+*/
+void sector_offset_encode(uint32_t address, uint8_t * offset)
+{
+    unsigned msf[3];
+    unsigned i;
+
+    address %= ADDRESS_COUNT;
+
+    msf[0] = (unsigned)(address / 4500);
+    msf[1] = (unsigned)(address / 75 % 60);
+    msf[2] = (unsigned)(address % 75);
+
+    for (i = 0; i < 3; i++)
+    {
+        offset[i] = (uint8_t)((msf[i] / 10) << 4 | msf[i] % 10);
+    }
+}
+
+/*
+    Initialize a header address continuity check
+*/
+void sector_address_check_init(sector_address_check * check)
+{
+    memset(check, 0, sizeof(*check));
+}
+
+/*
+    Check the header address of one sector against its position
+*/
+sector_address_status sector_address_check_sector(sector_address_check * check,
+                                                  const void * sector,
+                                                  uint32_t     sector_num)
+{
+    return check_address(check, (const uint8_t *)sector, sector_num);
+}
+
+/*
+    Check the header addresses of consecutive sectors
+*/
+uint32_t sector_address_check_sectors(sector_address_check *  check,
+                                      const void *            sectors,
+                                      uint32_t                sector_num,
+                                      uint32_t                count,
+                                      sector_address_status * status)
+{
+    const uint8_t *       p;
+    sector_address_status result;
+    uint32_t              i;
+
+    p = (const uint8_t *)sectors;
+
+    for (i = 0; i < count; i++, p += 2352)
+    {
+        result = check_address(check, p, sector_num + i);
+
+        if (result != SECTOR_ADDRESS_OK && result != SECTOR_ADDRESS_NONE)
+        {
+            *status = result;
+
+            return i + 1;
+        }
+    }
+
+    *status = SECTOR_ADDRESS_OK;
+
+    return count;
+}
+
+/*
+    Size of the user data for a mode
+*/
+unsigned sector_data_size(sector_mode mode)
+{
+    /* clang-format off */
+    switch (mode)
+    {
+        case SECTOR_MODE_0:
+            return 2336;
+        case SECTOR_MODE_1:
+            return 2048;
+        case SECTOR_MODE_2:
+            return 2336;
+        case SECTOR_MODE_2_FORM_1:
+            return 2048;
+        case SECTOR_MODE_2_FORM_2:
+            return 2324;
+        default:
+            return 0;
+    }
+    /* clang-format on */
+}
+
+/*
+    Initialize a streaming decoder
+*/
+void sector_stream_init(sector_stream *        stream,
+                        sector_stream_callback callback,
+                        void *                 user)
+{
+    stream->callback   = callback;
+    stream->user       = user;
+    stream->sector_num = 0;
+    stream->carry_size = 0;
+}
+
+/*
+    Decode an arbitrary chunk of a raw image
+*/
+sector_error sector_stream_push(sector_stream * stream,
+                                const void *    data,
+                                size_t          size)
+{
+    const uint8_t * p;
+    sector_error    error;
+
+    p = (const uint8_t *)data;
+
+    /* Complete the sector carried over from the previous push */
+    if (stream->carry_size)
+    {
+        size_t fill;
+
+        fill = 2352 - stream->carry_size;
+
+        if (size < fill)
+        {
+            memcpy(&stream->carry[stream->carry_size], p, size);
+            stream->carry_size += (unsigned)size;
+
+            return SECTOR_ERROR_NONE;
+        }
+
+        memcpy(&stream->carry[stream->carry_size], p, fill);
+        stream->carry_size = 0;
+
+        p    += fill;
+        size -= fill;
+
+        if ((error = stream_sector(stream, &stream->carry[0])))
+        {
+            return error;
+        }
+    }
+
+    /* Decode whole sectors in place */
+    while (size >= 2352)
+    {
+        if ((error = stream_sector(stream, p)))
+        {
+            return error;
+        }
+
+        p    += 2352;
+        size -= 2352;
+    }
+
+    memcpy(&stream->carry[0], p, size);
+    stream->carry_size = (unsigned)size;
+
+    return SECTOR_ERROR_NONE;
+}
+
+/*
+    Finish decoding
+*/
+sector_error sector_stream_finish(sector_stream * stream)
+{
+    return stream->carry_size ? SECTOR_ERROR_TRUNCATED : SECTOR_ERROR_NONE;
+}
+
 /*
     Stringify mode
 */
@@ -302,6 +693,36 @@ const char * sector_error_string(sector_error error)
             return "Sector is either Mode 2 or Mode 2 Form 1 with corrupt EDC";
         case SECTOR_ERROR_MODE_2_F2_AMBIGUOUS:
             return "Sector is either Mode 2 or Mode 2 Form 2 with corrupt EDC";
+        case SECTOR_ERROR_ABORTED:
+            return "Decoding aborted by callback";
+        case SECTOR_ERROR_TRUNCATED:
+            return "Data ends with a partial sector";
+        default:
+            return "Unknown error";
+    }
+    /* clang-format on */
+}
+
+/*
+    Stringify address check result
+*/
+const char * sector_address_string(sector_address_status status)
+{
+    /* clang-format off */
+    switch (status)
+    {
+        case SECTOR_ADDRESS_OK:
+            return "Address in sequence";
+        case SECTOR_ADDRESS_NONE:
+            return "Sector has no header address";
+        case SECTOR_ADDRESS_INVALID:
+            return "Invalid BCD header address";
+        case SECTOR_ADDRESS_GAP:
+            return "Address skips forward, sectors missing";
+        case SECTOR_ADDRESS_DUPLICATE:
+            return "Address repeats the previous sector";
+        case SECTOR_ADDRESS_OUT_OF_ORDER:
+            return "Address goes backwards, sector out of order";
         default:
             return "Unknown error";
     }